@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <vector>
 #include <functional>
 
@@ -35,14 +37,13 @@ void binary_heap<T, Compare>::percolate_up(int start_i) {
     int i = start_i;
     while (i > 1) {
         int parent_i = i / 2;
-        // printf("Comparing at %d %d\n", i, parent_i);
-        if (Compare()(this->v[parent_i], this->v[i])) {
-            // printf("less: %d %d\n", this->v[i], this->v[parent_i]);
-            const T el = this->v[i];
-            this->v[i] = this->v[parent_i];
-            this->v[parent_i] = el;
-            // printf("now: %d %d\n", this->v[i], this->v[parent_i]);
+        if (!Compare()(this->v[parent_i], this->v[i])) {
+            // the rest of the way to the root is already in order
+            break;
         }
+        const T el = this->v[i];
+        this->v[i] = this->v[parent_i];
+        this->v[parent_i] = el;
         i = parent_i;
     }
 }
@@ -64,11 +65,12 @@ void binary_heap<T, Compare>::percolate_down(int start_i) {
     int i = start_i;
     while (i * 2 < this->v.size()) {
         int child_i = min_child_i(i);
-        if (Compare()(this->v[i], this->v[child_i])) {
-            const T el = this->v[i];
-            this->v[i] = this->v[child_i];
-            this->v[child_i] = el;
+        if (!Compare()(this->v[i], this->v[child_i])) {
+            break;
         }
+        const T el = this->v[i];
+        this->v[i] = this->v[child_i];
+        this->v[child_i] = el;
         i = child_i;
     }
 }
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Checks that the -g tree search tries cells and values in the same order
+# as the in-place search: for every puzzle and branching order, it has to
+# expand the same nodes, plus the root that tree_search counts too.
+#
+# ./check_orders.sh [puzzles] (default puzzles/hardest.txt)
+
+puzzles=${1:-puzzles/hardest.txt}
+failed=0
+
+expansions() {
+    # --stats goes to stderr, and the solution to stdout
+    echo "$1" | ./sudoku -b -j1 --stats $2 2>&1 >/dev/null |
+        sed -n 's/.*"expansion_count": \([0-9]*\).*/\1/p'
+}
+
+for cell_order in first mrv-degree; do
+    for value_order in lowest lcv hidden; do
+        options="--cell-order $cell_order --value-order $value_order"
+        line_number=0
+        grep -v '^#' "$puzzles" | while read -r puzzle; do
+            line_number=$((line_number + 1))
+            in_place=$(expansions "$puzzle" "$options")
+            tree=$(expansions "$puzzle" "-g $options")
+            if [ "$tree" != "$((in_place + 1))" ]; then
+                echo "puzzle $line_number, $options:" \
+                     "$in_place expanded in place, $tree with -g"
+            fi
+        done
+    done
+done | grep . && failed=1
+
+if [ $failed -ne 0 ]; then
+    echo "-g doesn't try the same order as the in-place search" >&2
+    exit 1
+fi
+echo "-g and in place expand the same nodes on $puzzles"
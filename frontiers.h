@@ -0,0 +1,313 @@
+#pragma once
+
+// Frontier types for the templated tree_search in search_engine.h.
+// queues.cpp wraps the same types for the populate_with_* queues.
+// push returns a node the frontier dropped for the search to delete,
+// which only indexed_heap_frontier ever does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+#include "binary_heap.h"
+#include "general_search.h"
+#include "search_engine.h"
+
+using std::unordered_map;
+using std::vector;
+
+// put low costs at the top of the priority queue
+class Node_Compare {
+ public:
+    bool operator() (gen_search_node_t *a, gen_search_node_t *b) {
+        return a->ordering_cost > b->ordering_cost;
+    }
+};
+
+class priority_frontier {
+    binary_heap<gen_search_node_t*, Node_Compare> heap;
+ public:
+    bool empty() {
+        return heap.empty();
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        heap.push(node);
+        return NULL;
+    }
+    gen_search_node_t *pop() {
+        if (heap.empty()) {
+            return NULL;
+        }
+        gen_search_node_t *top = heap.top();
+        heap.pop();
+        return top;
+    }
+};
+
+// Like priority_frontier, with 4 children per heap node, so the heap is
+// half as deep, and each node's ordering_cost kept next to it, so
+// comparisons don't go out to the nodes
+class dary_heap_frontier {
+    static const int ARITY = 4;
+    typedef struct entry {
+        float cost;
+        gen_search_node_t *node;
+    } entry_t;
+    vector<entry_t> heap;
+ public:
+    bool empty() {
+        return heap.empty();
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        entry_t entry = { node->ordering_cost, node };
+        // move parents down into the hole until entry fits
+        size_t i = heap.size();
+        heap.push_back(entry);
+        while (i > 0) {
+            size_t parent_i = (i - 1) / ARITY;
+            if (heap[parent_i].cost <= entry.cost) {
+                break;
+            }
+            heap[i] = heap[parent_i];
+            i = parent_i;
+        }
+        heap[i] = entry;
+        return NULL;
+    }
+    gen_search_node_t *pop() {
+        if (heap.empty()) {
+            return NULL;
+        }
+        gen_search_node_t *top = heap[0].node;
+        entry_t last = heap.back();
+        heap.pop_back();
+        size_t n = heap.size();
+        if (n == 0) {
+            return top;
+        }
+        // move the least child up into the hole until last fits
+        size_t i = 0;
+        while (1) {
+            size_t first_child = i * ARITY + 1;
+            if (first_child >= n) {
+                break;
+            }
+            size_t end = first_child + ARITY < n ? first_child + ARITY : n;
+            size_t min_i = first_child;
+            for (size_t child_i = first_child + 1; child_i < end; child_i++) {
+                if (heap[child_i].cost < heap[min_i].cost) {
+                    min_i = child_i;
+                }
+            }
+            if (last.cost <= heap[min_i].cost) {
+                break;
+            }
+            heap[i] = heap[min_i];
+            i = min_i;
+        }
+        heap[i] = last;
+        return top;
+    }
+};
+
+// Priority frontier for ordering costs that are small non-negative whole
+// numbers, as with unit step costs: one bucket per cost, so push and pop
+// are O(1) apart from stepping over empty buckets. Fractions are rounded
+// down. Nodes of the same cost come out last in, first out, so a search
+// tends to finish one path before starting another.
+// Buckets are kept between searches, so they stop allocating once warm.
+class bucket_frontier {
+    vector<vector<gen_search_node_t*> > buckets;
+    // no bucket below this holds a node
+    size_t min_bucket;
+    size_t size;
+ public:
+    bucket_frontier() : min_bucket(0), size(0) {
+    }
+    bool empty() {
+        return size == 0;
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        if (!(node->ordering_cost >= 0)) {
+            fprintf(stderr, "Fatal Error: bucket_frontier needs costs of "
+                            "0 or more, not %f\n", node->ordering_cost);
+            exit(1);
+        }
+        size_t bucket = (size_t)node->ordering_cost;
+        if (bucket >= buckets.size()) {
+            buckets.resize(bucket + 1);
+        }
+        buckets[bucket].push_back(node);
+        if (bucket < min_bucket) {
+            min_bucket = bucket;
+        }
+        size++;
+        return NULL;
+    }
+    gen_search_node_t *pop() {
+        if (size == 0) {
+            return NULL;
+        }
+        while (buckets[min_bucket].empty()) {
+            min_bucket++;
+        }
+        gen_search_node_t *node = buckets[min_bucket].back();
+        buckets[min_bucket].pop_back();
+        size--;
+        if (size == 0) {
+            min_bucket = 0;
+        }
+        return node;
+    }
+};
+
+// A binary heap that holds one node per state, by state_hash, so it
+// needs a search that doesn't allow cycles (tree_search checks this).
+// Pushing a cheaper node for a state already waiting takes the old node's
+// place and moves it up (decrease-key), instead of leaving both in the
+// heap, and the old node is returned to be deleted. A node no cheaper
+// than the one waiting is returned itself.
+class indexed_heap_frontier {
+    typedef struct entry {
+        float cost;
+        gen_search_node_t *node;
+    } entry_t;
+    vector<entry_t> heap;
+    unordered_map<uint64_t, gen_search_node_t*> waiting;
+
+    void place(size_t i, const entry_t &entry) {
+        heap[i] = entry;
+        entry.node->frontier_index = i;
+    }
+    void sift_up(size_t i, entry_t entry) {
+        while (i > 0) {
+            size_t parent_i = (i - 1) / 2;
+            if (heap[parent_i].cost <= entry.cost) {
+                break;
+            }
+            place(i, heap[parent_i]);
+            i = parent_i;
+        }
+        place(i, entry);
+    }
+    void sift_down(size_t i, entry_t entry) {
+        size_t n = heap.size();
+        while (1) {
+            size_t child_i = i * 2 + 1;
+            if (child_i >= n) {
+                break;
+            }
+            if (child_i + 1 < n &&
+                    heap[child_i + 1].cost < heap[child_i].cost) {
+                child_i++;
+            }
+            if (entry.cost <= heap[child_i].cost) {
+                break;
+            }
+            place(i, heap[child_i]);
+            i = child_i;
+        }
+        place(i, entry);
+    }
+ public:
+    bool empty() {
+        return heap.empty();
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        entry_t entry = { node->ordering_cost, node };
+        auto found = waiting.find(node->state_hash);
+        if (found == waiting.end()) {
+            waiting[node->state_hash] = node;
+            heap.push_back(entry);
+            sift_up(heap.size() - 1, entry);
+            return NULL;
+        }
+        gen_search_node_t *old = found->second;
+        if (old->ordering_cost <= node->ordering_cost) {
+            return node;
+        }
+        found->second = node;
+        sift_up(old->frontier_index, entry);
+        return old;
+    }
+    gen_search_node_t *pop() {
+        if (heap.empty()) {
+            return NULL;
+        }
+        gen_search_node_t *top = heap[0].node;
+        waiting.erase(top->state_hash);
+        entry_t last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            sift_down(0, last);
+        }
+        return top;
+    }
+};
+
+template <>
+struct frontier_uses_state_hash<indexed_heap_frontier> {
+    static const bool value = true;
+};
+
+// First in, first out, in a ring buffer that doubles when full, so pushes
+// and pops don't allocate once it has grown to the largest frontier seen
+class fifo_frontier {
+    vector<gen_search_node_t*> ring;
+    // ring.size() is always a power of 2, or 0
+    size_t head;
+    size_t size;
+    void grow() {
+        size_t capacity = ring.size();
+        vector<gen_search_node_t*> larger(capacity ? capacity * 2 : 64);
+        for (size_t k = 0; k < size; k++) {
+            larger[k] = ring[(head + k) & (capacity - 1)];
+        }
+        ring.swap(larger);
+        head = 0;
+    }
+ public:
+    fifo_frontier() : head(0), size(0) {
+    }
+    bool empty() {
+        return size == 0;
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        if (size == ring.size()) {
+            grow();
+        }
+        ring[(head + size) & (ring.size() - 1)] = node;
+        size++;
+        return NULL;
+    }
+    gen_search_node_t *pop() {
+        if (size == 0) {
+            return NULL;
+        }
+        gen_search_node_t *element = ring[head];
+        head = (head + 1) & (ring.size() - 1);
+        size--;
+        return element;
+    }
+};
+
+// Last in, first out, on a vector that keeps its memory between pushes
+class lifo_frontier {
+    vector<gen_search_node_t*> nodes;
+ public:
+    bool empty() {
+        return nodes.empty();
+    }
+    gen_search_node_t *push(gen_search_node_t *node) {
+        nodes.push_back(node);
+        return NULL;
+    }
+    gen_search_node_t *pop() {
+        if (nodes.empty()) {
+            return NULL;
+        }
+        gen_search_node_t *element = nodes.back();
+        nodes.pop_back();
+        return element;
+    }
+};
@@ -1,4 +1,5 @@
 #include "general_search.h"
+#include "search_engine.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,36 +7,6 @@
 #define node_t gen_search_node_t
 #define problem_t general_search_problem_t
 
-node_t *make_node(problem_t *p, node_t *parent, void *state, int32_t action) {
-    node_t *node = (node_t*)calloc(1, sizeof(node_t));
-    node->state = state;
-    node->parent = parent;
-    node->action = action;
-    node->depth = parent ? parent->depth + 1 : 0;
-    node->path_cost = parent ?
-                        (parent->path_cost + p->step_cost(node, action)) : 0;
-    node->ordering_cost = p->ordering_cost(node);
-    node->n_alive_children = 0;
-    if (parent) {
-        parent->n_alive_children++;
-    }
-    return node;
-}
-
-void delete_node(problem_t *p, node_t *node) {
-    node_t *parent = node->parent;
-    if (parent) {
-        p->destroy_state(node->state);
-    }
-    free(node);
-    if (parent) {
-        parent->n_alive_children--;
-        if (parent->n_alive_children == 0) {
-            delete_node(p, parent);
-        }
-    }
-}
-
 float step_cost_one(node_t *node, int32_t action) {
     return 1;
 }
@@ -59,13 +30,6 @@ bool has_function(bool has_f, const char* name) {
     return true;
 }
 
-void clear_queue(problem_t *p, void *q) {
-    node_t *node = NULL;
-    while ((node = (node_t*)p->queue_remove_first(q))) {
-        delete_node(p, node);
-    }
-}
-
 // Checks the problem is correctly filled out
 // provides some default implementations
 bool check_problem(problem_t *p) {
@@ -85,22 +49,13 @@ bool check_problem(problem_t *p) {
     if (!p->destroy_state) {
         p->destroy_state = blank_state_destroy;
     }
-    if (p->use_iterative_depth && p->iterative_depth_init < 0) {
-        fprintf(stderr,
-            "Error: Problem iterative_depth_init must be non-negative\n");
-        return false;
-    }
-    if (p->use_iterative_depth && p->iterative_depth_increment < 0) {
-        fprintf(stderr,
-            "Error: Problem iterative_depth_increment must be non-negative\n");
-        return false;
-    }
-    if (!p->initial_state) {
-        fprintf(stderr, "Error: Problem missing necessary initial_state\n");
+    if (!check_search_options(p)) {
         return false;
     }
 
-    if (!p->allow_cycles && (
+    // the depth-first modes hold only a path, with no frontier or set
+    bool needs_frontier = !p->use_ida_star && !p->use_rbfs;
+    if (!p->allow_cycles && needs_frontier && (
             !has_function(!!p->unordered_set_make,
                             "unordered_set_make") ||
             !has_function(!!p->unordered_set_destroy,
@@ -113,124 +68,125 @@ bool check_problem(problem_t *p) {
         return false;
     }
 
-    return has_function(!!p->is_goal, "is_goal") &&
-            has_function(!!p->expand_state, "expand_state") &&
-            has_function(!!p->next_new_state, "states_length") &&
-            has_function(!!p->queue_make, "queue_make") &&
+    if (!has_function(!!p->is_goal, "is_goal") ||
+            !has_function(!!p->expand_state, "expand_state") ||
+            !has_function(!!p->next_new_state, "states_length")) {
+        return false;
+    }
+    return !needs_frontier ||
+            (has_function(!!p->queue_make, "queue_make") &&
             has_function(!!p->queue_destroy, "queue_destroy") &&
             has_function(!!p->queue_add, "queue_add") &&
-            has_function(!!p->queue_remove_first, "queue_remove_first");
-}
-
-void general_search_result_destroy(problem_t *p, node_t *result) {
-    delete_node(p, result);
+            has_function(!!p->queue_remove_first, "queue_remove_first"));
 }
 
-node_t *inner_tree_search(problem_t *p, bool *needs_depth_increase) {
-    void *frontier = p->queue_make();
-    p->queue_add(frontier, make_node(p, NULL, p->initial_state, 0));
-
-    void *expanded_set;
-    if (!p->allow_cycles) {
-        expanded_set = p->unordered_set_make();
+// Adapts the function pointers of a problem to the interface
+// the templated tree_search expects
+class c_search_problem {
+    problem_t *p;
+ public:
+    c_search_problem(problem_t *p) : p(p) {
     }
-
-    while (1) {
-        if (p->queue_is_empty(frontier)) {
-            clear_queue(p, frontier);
-            p->queue_destroy(frontier);
-            if (!p->allow_cycles) {
-                p->unordered_set_destroy(expanded_set);
-            }
-            return NULL;
-        }
-
-        node_t *node = (node_t*)p->queue_remove_first(frontier);
-
-        if (!p->allow_cycles) {
-            uint64_t state_hash = p->calc_state_hash(node->state);
-            if (p->unordered_set_contains(expanded_set, state_hash)) {
-                // already expanded
-                delete_node(p, node);
-                continue;
-            }
-        }
-
-        if (p->debugging) {
-            printf("Expanding node with path_cost: %.2f depth: %d ",
-                    node->path_cost, node->depth);
-        }
-        p->expansion_count++;
-
-        if (p->is_goal(node)) {
-            clear_queue(p, frontier);
-            p->queue_destroy(frontier);
-            if (!p->allow_cycles) {
-                p->unordered_set_destroy(expanded_set);
-            }
-            if (p->debugging) {
-                printf("\n");
-            }
-            return node;
-        }
-
-        if (p->use_iterative_depth &&
-                node->depth >= p->_iterative_depth_limit) {
-            delete_node(p, node);
-            if (p->iterative_depth_increment > 0) {
-                *needs_depth_increase = true;
-            }
-            if (p->debugging) {
-                printf("\n");
-            }
-            continue;
+    bool is_goal(node_t *node) {
+        return p->is_goal(node);
+    }
+    float step_cost(node_t *node, int32_t action) {
+        return p->step_cost(node, action);
+    }
+    float ordering_cost(node_t *node) {
+        return p->ordering_cost(node);
+    }
+    void *expand_state(void *state) {
+        return p->expand_state(state);
+    }
+    bool next_new_state(void *expansion,
+                        void **new_state, int32_t *new_action) {
+        return p->next_new_state(expansion, new_state, new_action);
+    }
+    uint64_t calc_state_hash(void *state) {
+        return p->calc_state_hash(state);
+    }
+    uint64_t child_state_hash(uint64_t state_hash, void *state,
+                              void *new_state, int32_t action) {
+        if (p->state_hash_delta) {
+            return state_hash ^ p->state_hash_delta(state, new_state, action);
         }
+        return p->calc_state_hash(new_state);
+    }
+    void destroy_state(void *state) {
+        p->destroy_state(state);
+    }
+    bool should_stop() {
+        return p->should_stop && p->should_stop(p->stop_context);
+    }
+};
 
-        void *expansion = p->expand_state(node->state);
-        if (!p->allow_cycles) {
-            uint64_t state_hash = p->calc_state_hash(node->state);
-            p->unordered_set_add(expanded_set, state_hash);
+class c_frontier {
+    problem_t *p;
+    void *q;
+ public:
+    c_frontier(problem_t *p)
+            : p(p), q(p->queue_make ? p->queue_make() : NULL) {
+    }
+    ~c_frontier() {
+        if (q) {
+            p->queue_destroy(q);
         }
+    }
+    bool empty() {
+        return p->queue_is_empty(q);
+    }
+    node_t *push(node_t *node) {
+        p->queue_add(q, node);
+        return NULL;
+    }
+    node_t *pop() {
+        return (node_t*)p->queue_remove_first(q);
+    }
+};
 
-        int32_t nodes_added = 0;
-        void *new_state = NULL;
-        int32_t new_action = -1;
-        while (p->next_new_state(expansion, &new_state, &new_action)) {
-            if (!p->allow_cycles) {
-                uint64_t state_hash = p->calc_state_hash(new_state);
-                if (p->unordered_set_contains(expanded_set, state_hash)) {
-                    continue;
-                }
-            }
-            node_t *new_node = make_node(p, node, new_state, new_action);
-            p->queue_add(frontier, new_node);
-            nodes_added++;
+// only touches the set functions when cycles are not allowed
+class c_visited_set {
+    problem_t *p;
+    void *s;
+ public:
+    c_visited_set(problem_t *p) : p(p), s(NULL) {
+    }
+    ~c_visited_set() {
+        if (s) {
+            p->unordered_set_destroy(s);
         }
-        if (nodes_added == 0) {
-            // leaf node will be forgotten
-            delete_node(p, node);
+    }
+    void clear() {
+        if (s) {
+            p->unordered_set_destroy(s);
         }
-
-        if (p->debugging) {
-            printf("\n");
+        s = p->unordered_set_make();
+    }
+    void reserve(size_t n) {
+        if (p->unordered_set_reserve) {
+            p->unordered_set_reserve(s, n);
         }
     }
+    void add(uint64_t hash) {
+        p->unordered_set_add(s, hash);
+    }
+    bool contains(uint64_t hash) {
+        return p->unordered_set_contains(s, hash);
+    }
+};
+
+void general_search_result_destroy(problem_t *p, node_t *result) {
+    c_search_problem problem(p);
+    general_search_result_destroy(p, problem, result);
 }
 
 node_t *tree_search(problem_t *p) {
     if (!check_problem(p)) {
         return NULL;
     }
-    p->_iterative_depth_limit = p->iterative_depth_init;
-
-    bool needs_depth_increase = false;
-    node_t *result = inner_tree_search(p, &needs_depth_increase);
-    while (!result && needs_depth_increase && p->_iterative_depth_limit < 500) {
-        p->_iterative_depth_limit += p->iterative_depth_increment;
-        printf("Increasing iterative-depth limit to %d\n",
-                p->_iterative_depth_limit);
-        result = inner_tree_search(p, &needs_depth_increase);
-    }
-
-    return result;
+    c_search_problem problem(p);
+    c_frontier frontier(p);
+    c_visited_set expanded_set(p);
+    return tree_search(p, problem, frontier, expanded_set);
 }
@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "pool.h"
 
 typedef struct node {
     void *state;
@@ -11,6 +12,10 @@ typedef struct node {
     float path_cost;
     float ordering_cost;
     int n_alive_children;
+    // of state, kept only when cycles aren't allowed
+    uint64_t state_hash;
+    // internal, its place in an indexed_heap_frontier
+    int32_t frontier_index;
 } gen_search_node_t;
 
 typedef struct problem {
@@ -21,11 +26,41 @@ typedef struct problem {
     bool allow_cycles;
     bool debugging;
 
+    // nodes come from a pool that is freed in one go once the search
+    // (and its result) are done, instead of one calloc and free per node
+    bool use_node_pool;
+    pool_t _node_pool; // internal
+
+    // optional, how many states to size the expanded-state set for
+    // up front, so it doesn't keep growing during the search
+    int32_t expected_state_count;
+
     bool use_iterative_depth;
     int32_t iterative_depth_init;
     int32_t iterative_depth_increment;
+    // optional, the deepest limit tried before giving up (default 500)
+    int32_t iterative_depth_max;
     int32_t _iterative_depth_limit; // internal, factor of the above
 
+    // IDA*: depth-first passes that cut off nodes whose ordering_cost is
+    // over a threshold, raised each pass to the least ordering_cost that
+    // was cut off. ordering_cost should be an f-cost (path cost plus an
+    // admissible heuristic). Only the current path is kept in memory.
+    // The frontier and expanded-state set aren't used, and as children are
+    // made one at a time, an expansion of each node on the path is open at
+    // once (so expand_state can't share one between calls).
+    bool use_ida_star;
+    // Recursive best-first search: expands in best-first order while only
+    // keeping the current path and the children of each node on it,
+    // remembering the best f-cost below each child it backs out of.
+    // Like IDA*, it doesn't use the frontier or expanded-state set.
+    bool use_rbfs;
+    // optional, most nodes alive at once before the search gives up and
+    // sets out_of_budget, 0 for no limit
+    int32_t node_budget;
+    bool out_of_budget;
+    int32_t _n_live_nodes; // internal
+
     bool (*is_goal)(gen_search_node_t *node);
     float (*step_cost)(gen_search_node_t *node, int32_t action);
     float (*ordering_cost)(gen_search_node_t *node);
@@ -41,8 +76,18 @@ typedef struct problem {
     // optional to allow state comparison (as in cycles)
     // by hash value instead of pointer value
     uint64_t (*calc_state_hash)(void *state);
+    // optional, what new_state's hash differs from state's by, when
+    // new_state came from state by action. It is XORed into the hash the
+    // parent node keeps, so cycle checks cost O(1) and not a call to
+    // calc_state_hash (as with Zobrist hashing)
+    uint64_t (*state_hash_delta)(void *state, void *new_state,
+                                 int32_t action);
     // optional for freeing state resources
     void (*destroy_state)(void *state);
+    // optional, checked before every expansion. Once it returns true
+    // the search gives up and returns NULL. Lets other threads cancel it.
+    bool (*should_stop)(void *stop_context);
+    void *stop_context;
 
     void *(*queue_make)();
     void (*queue_destroy)(void *q);
@@ -54,6 +99,8 @@ typedef struct problem {
     void (*unordered_set_destroy)(void *s);
     void (*unordered_set_add)(void *s, uint64_t value);
     bool (*unordered_set_contains)(void *s, uint64_t value);
+    // optional, for expected_state_count
+    void (*unordered_set_reserve)(void *s, size_t n);
 } general_search_problem_t;
 
 gen_search_node_t *tree_search(general_search_problem_t *p);
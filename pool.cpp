@@ -0,0 +1,77 @@
+#include "pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POOL_ALIGNMENT 16
+#define POOL_FIRST_CHUNK_BLOCKS 32
+#define POOL_MAX_CHUNK_BLOCKS 4096
+
+size_t pool_round_up(size_t size) {
+    return (size + POOL_ALIGNMENT - 1) & ~(size_t)(POOL_ALIGNMENT - 1);
+}
+
+void pool_init(pool_t *pool, size_t block_size) {
+    // every block must at least fit the free list link
+    if (block_size < sizeof(void*)) {
+        block_size = sizeof(void*);
+    }
+    pool->block_size = pool_round_up(block_size);
+    pool->next_chunk_blocks = POOL_FIRST_CHUNK_BLOCKS;
+    pool->free_list = NULL;
+    pool->chunk_next = NULL;
+    pool->chunk_end = NULL;
+    pool->chunks = NULL;
+}
+
+void pool_add_chunk(pool_t *pool) {
+    // chunk header is just the link to the previous chunk
+    size_t header_size = pool_round_up(sizeof(void*));
+    size_t blocks_size = pool->block_size * pool->next_chunk_blocks;
+    char *chunk = (char*)malloc(header_size + blocks_size);
+    if (!chunk) {
+        fprintf(stderr, "Fatal Error: pool failed to allocate %zu bytes\n",
+                header_size + blocks_size);
+        exit(1);
+    }
+    *(void**)chunk = pool->chunks;
+    pool->chunks = chunk;
+    pool->chunk_next = chunk + header_size;
+    pool->chunk_end = pool->chunk_next + blocks_size;
+
+    if (pool->next_chunk_blocks < POOL_MAX_CHUNK_BLOCKS) {
+        pool->next_chunk_blocks *= 2;
+    }
+}
+
+void *pool_alloc(pool_t *pool) {
+    if (pool->free_list) {
+        void *block = pool->free_list;
+        pool->free_list = *(void**)block;
+        return block;
+    }
+    if (pool->chunk_next == pool->chunk_end) {
+        pool_add_chunk(pool);
+    }
+    void *block = pool->chunk_next;
+    pool->chunk_next += pool->block_size;
+    return block;
+}
+
+void pool_free(pool_t *pool, void *block) {
+    *(void**)block = pool->free_list;
+    pool->free_list = block;
+}
+
+void pool_destroy(pool_t *pool) {
+    void *chunk = pool->chunks;
+    while (chunk) {
+        void *next = *(void**)chunk;
+        free(chunk);
+        chunk = next;
+    }
+    pool->free_list = NULL;
+    pool->chunk_next = NULL;
+    pool->chunk_end = NULL;
+    pool->chunks = NULL;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+// Pool of fixed-size blocks for objects that are created and destroyed
+// constantly, like search nodes and states. Blocks are carved out of
+// ever larger chunks, recycled through a free list when released,
+// and all chunks are returned to the system together by pool_destroy.
+typedef struct pool {
+    size_t block_size;
+    size_t next_chunk_blocks;
+    // released blocks, linked through their first word
+    void *free_list;
+    // never-used space at the end of the newest chunk
+    char *chunk_next;
+    char *chunk_end;
+    // every chunk, linked through their first word
+    void *chunks;
+} pool_t;
+
+void pool_init(pool_t *pool, size_t block_size);
+// contents of the returned block are undefined
+void *pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *block);
+// frees every block at once, whether or not it was released
+void pool_destroy(pool_t *pool);
@@ -2,49 +2,26 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <list>
-#include <forward_list>
-#include "binary_heap.h"
-
-using std::list;
-using std::forward_list;
-
-// put low costs at the top of the priority queue
-class Node_Compare {
- public:
-    bool operator() (void *a, void *b) {
-        return ((gen_search_node_t*)a)->ordering_cost >
-                ((gen_search_node_t*)b)->ordering_cost;
-    }
-};
-
-typedef binary_heap<void*, Node_Compare> p_queue_t;
-// typedef priority_queue<void*, deque<void*>, Node_Compare> p_queue_t;
+#include "frontiers.h"
 
 void *priority_queue_make() {
-    return new p_queue_t();
+    return new priority_frontier();
 }
 
 void priority_queue_destroy(void *q) {
-    delete (p_queue_t*)q;
+    delete (priority_frontier*)q;
 }
 
 void priority_queue_add(void *q, void *value) {
-    ((p_queue_t*)q)->push(value);
+    ((priority_frontier*)q)->push((gen_search_node_t*)value);
 }
 
 bool priority_queue_is_empty(void *q) {
-    return ((p_queue_t*)q)->empty();
+    return ((priority_frontier*)q)->empty();
 }
 
 void *priority_queue_remove_first(void *q) {
-    p_queue_t *queue = (p_queue_t*)q;
-    if (queue->empty()) {
-        return NULL;
-    }
-    void *top = queue->top();
-    queue->pop();
-    return top;
+    return ((priority_frontier*)q)->pop();
 }
 
 void populate_with_priority_queue(general_search_problem_t *p) {
@@ -55,32 +32,80 @@ void populate_with_priority_queue(general_search_problem_t *p) {
     p->queue_remove_first = priority_queue_remove_first;
 }
 
-typedef list<void*> fifo_queue_t;
+void *dary_heap_queue_make() {
+    return new dary_heap_frontier();
+}
+
+void dary_heap_queue_destroy(void *q) {
+    delete (dary_heap_frontier*)q;
+}
+
+void dary_heap_queue_add(void *q, void *value) {
+    ((dary_heap_frontier*)q)->push((gen_search_node_t*)value);
+}
+
+bool dary_heap_queue_is_empty(void *q) {
+    return ((dary_heap_frontier*)q)->empty();
+}
+
+void *dary_heap_queue_remove_first(void *q) {
+    return ((dary_heap_frontier*)q)->pop();
+}
+
+void populate_with_dary_heap(general_search_problem_t *p) {
+    p->queue_make = dary_heap_queue_make;
+    p->queue_destroy = dary_heap_queue_destroy;
+    p->queue_add = dary_heap_queue_add;
+    p->queue_is_empty = dary_heap_queue_is_empty;
+    p->queue_remove_first = dary_heap_queue_remove_first;
+}
+
+void *bucket_queue_make() {
+    return new bucket_frontier();
+}
+
+void bucket_queue_destroy(void *q) {
+    delete (bucket_frontier*)q;
+}
+
+void bucket_queue_add(void *q, void *value) {
+    ((bucket_frontier*)q)->push((gen_search_node_t*)value);
+}
+
+bool bucket_queue_is_empty(void *q) {
+    return ((bucket_frontier*)q)->empty();
+}
+
+void *bucket_queue_remove_first(void *q) {
+    return ((bucket_frontier*)q)->pop();
+}
+
+void populate_with_bucket_queue(general_search_problem_t *p) {
+    p->queue_make = bucket_queue_make;
+    p->queue_destroy = bucket_queue_destroy;
+    p->queue_add = bucket_queue_add;
+    p->queue_is_empty = bucket_queue_is_empty;
+    p->queue_remove_first = bucket_queue_remove_first;
+}
 
 void *fifo_queue_make() {
-    return new fifo_queue_t();
+    return new fifo_frontier();
 }
 
 void fifo_queue_destroy(void *q) {
-    delete (fifo_queue_t*)q;
+    delete (fifo_frontier*)q;
 }
 
 void fifo_queue_add(void *q, void *value) {
-    ((fifo_queue_t*)q)->push_back(value);
+    ((fifo_frontier*)q)->push((gen_search_node_t*)value);
 }
 
 bool fifo_queue_is_empty(void *q) {
-    return ((fifo_queue_t*)q)->empty();
+    return ((fifo_frontier*)q)->empty();
 }
 
 void *fifo_queue_remove_first(void *q) {
-    fifo_queue_t *queue = (fifo_queue_t*)q;
-    if (queue->empty()) {
-        return NULL;
-    }
-    void *element = queue->front();
-    queue->pop_front();
-    return element;
+    return ((fifo_frontier*)q)->pop();
 }
 
 void populate_with_fifo(general_search_problem_t *p) {
@@ -91,32 +116,24 @@ void populate_with_fifo(general_search_problem_t *p) {
     p->queue_remove_first = fifo_queue_remove_first;
 }
 
-typedef forward_list<void*> lifo_queue_t;
-
 void *lifo_queue_make() {
-    return new lifo_queue_t();
+    return new lifo_frontier();
 }
 
 void lifo_queue_destroy(void *q) {
-    delete (lifo_queue_t*)q;
+    delete (lifo_frontier*)q;
 }
 
 void lifo_queue_add(void *q, void *value) {
-    ((lifo_queue_t*)q)->push_front(value);
+    ((lifo_frontier*)q)->push((gen_search_node_t*)value);
 }
 
 bool lifo_queue_is_empty(void *q) {
-    return ((lifo_queue_t*)q)->empty();
+    return ((lifo_frontier*)q)->empty();
 }
 
 void *lifo_queue_remove_first(void *q) {
-    lifo_queue_t *queue = (lifo_queue_t*)q;
-    if (queue->empty()) {
-        return NULL;
-    }
-    void *element = queue->front();
-    queue->pop_front();
-    return element;
+    return ((lifo_frontier*)q)->pop();
 }
 
 void populate_with_lifo(general_search_problem_t *p) {
@@ -2,5 +2,8 @@
 #include "general_search.h"
 
 void populate_with_priority_queue(general_search_problem_t *p);
+// priority queues of the same order, see frontiers.h for when to use them
+void populate_with_dary_heap(general_search_problem_t *p);
+void populate_with_bucket_queue(general_search_problem_t *p);
 void populate_with_fifo(general_search_problem_t *p);
 void populate_with_lifo(general_search_problem_t *p);
@@ -0,0 +1,480 @@
+// Checks and times the frontiers in frontiers.h and the search modes of
+// the templated tree_search, all as graph searches.
+// - A* across a square grid of random 1-9 cell costs, from the top-left
+//   to the bottom-right corner, with each frontier. On small grids IDA*
+//   and RBFS run too.
+// - A*, IDA*, and RBFS on 15-puzzles, and each of them with a node budget.
+// - That tree_search turns indexed_heap_frontier away when cycles are
+//   allowed.
+// Everything has to find the same path cost as A* with the binary heap,
+// or it exits 1.
+//
+// ./search_bench [size ...] (default 8 60 300, then the 15-puzzles)
+
+#include "search_engine.h"
+#include "frontiers.h"
+#include "visited_sets.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_SIZES { 8, 60, 300 }
+#define RUNS 3
+// IDA* and RBFS take many passes on grids with varied costs, as each
+// pass only lets in the next few f-costs
+#define SMALL_GRID_MAX 10
+// 15-puzzles: seeds of the random walks, and how long they are
+#define TILES_SEEDS { 1, 2, 3 }
+#define TILES_WALK_LENGTH 400
+#define TILES_PATH_BUDGET 200
+
+double seconds() {
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now)) {
+        fprintf(stderr, "Retrieving system time failed.\n");
+        exit(1);
+    }
+    return now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+typedef struct grid {
+    int size;
+    // what stepping onto each cell costs, 1 to 9
+    unsigned char *costs;
+} grid_t;
+
+void grid_init(grid_t *grid, int size, uint64_t seed) {
+    grid->size = size;
+    grid->costs = (unsigned char*)malloc(size * size);
+    for (int i = 0; i < size * size; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        grid->costs[i] = 1 + (seed >> 33) % 9;
+    }
+}
+
+// states are cell + 1, as a search state can't be NULL
+static inline void *cell_state(int cell) {
+    return (void*)(intptr_t)(cell + 1);
+}
+
+static inline int state_cell(void *state) {
+    return (int)(intptr_t)state - 1;
+}
+
+typedef struct grid_expansion {
+    int cell;
+    int next_direction;
+} grid_expansion_t;
+
+class grid_problem {
+    grid_t *grid;
+    int goal;
+ public:
+    general_search_problem_t *p;
+    // most nodes alive at once, as of the last expansion
+    int32_t peak_live_nodes;
+
+    grid_problem(grid_t *grid) : grid(grid), p(NULL), peak_live_nodes(0) {
+        goal = grid->size * grid->size - 1;
+    }
+    bool is_goal(gen_search_node_t *node) {
+        return state_cell(node->state) == goal;
+    }
+    float step_cost(gen_search_node_t *node, int32_t action) {
+        return grid->costs[state_cell(node->state)];
+    }
+    // the Manhattan distance is admissible, as every step costs 1 or more
+    float ordering_cost(gen_search_node_t *node) {
+        int cell = state_cell(node->state);
+        int size = grid->size;
+        return node->path_cost + abs(cell % size - goal % size) +
+                                 abs(cell / size - goal / size);
+    }
+    void *expand_state(void *state) {
+        if (p && p->_n_live_nodes > peak_live_nodes) {
+            peak_live_nodes = p->_n_live_nodes;
+        }
+        grid_expansion_t *expansion =
+                        (grid_expansion_t*)malloc(sizeof(grid_expansion_t));
+        expansion->cell = state_cell(state);
+        expansion->next_direction = 0;
+        return expansion;
+    }
+    bool next_new_state(void *expansion,
+                        void **new_state, int32_t *new_action) {
+        static const int dx[4] = { 1, 0, -1, 0 };
+        static const int dy[4] = { 0, 1, 0, -1 };
+        grid_expansion_t *e = (grid_expansion_t*)expansion;
+        int size = grid->size;
+        while (e->next_direction < 4) {
+            int d = e->next_direction++;
+            int x = e->cell % size + dx[d];
+            int y = e->cell / size + dy[d];
+            if (x < 0 || y < 0 || x >= size || y >= size) {
+                continue;
+            }
+            *new_state = cell_state(y * size + x);
+            *new_action = d;
+            return true;
+        }
+        free(e);
+        return false;
+    }
+    uint64_t calc_state_hash(void *state) {
+        return (uint64_t)(intptr_t)state;
+    }
+    uint64_t child_state_hash(uint64_t state_hash, void *state,
+                              void *new_state, int32_t action) {
+        return calc_state_hash(new_state);
+    }
+    void destroy_state(void *state) {
+    }
+    bool should_stop() {
+        return false;
+    }
+};
+
+// Sliding tile boards are 4 bits a square, row by row, 0 for the blank,
+// so up to 4x4 fits in a state pointer
+
+static inline int tiles_at(uint64_t tiles, int i) {
+    return (tiles >> (4 * i)) & 15;
+}
+
+// tile i + 1 at square i, and the blank last
+uint64_t tiles_goal(int n) {
+    uint64_t tiles = 0;
+    for (int i = 0; i < n * n - 1; i++) {
+        tiles |= (uint64_t)(i + 1) << (4 * i);
+    }
+    return tiles;
+}
+
+int tiles_blank(uint64_t tiles, int n) {
+    for (int i = 0; i < n * n; i++) {
+        if (tiles_at(tiles, i) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// how far each tile is from its square in the goal, in moves
+int tiles_manhattan(uint64_t tiles, int n) {
+    int distance = 0;
+    for (int i = 0; i < n * n; i++) {
+        int tile = tiles_at(tiles, i);
+        if (tile == 0) {
+            continue;
+        }
+        int goal_i = tile - 1;
+        distance += abs(i % n - goal_i % n) + abs(i / n - goal_i / n);
+    }
+    return distance;
+}
+
+// Moves the blank one square in direction (0 to 3), into *moved.
+// returns false if that is off the board
+bool tiles_move(uint64_t tiles, int n, int blank, int direction,
+                uint64_t *moved) {
+    static const int dx[4] = { 1, -1, 0, 0 };
+    static const int dy[4] = { 0, 0, 1, -1 };
+    int x = blank % n + dx[direction];
+    int y = blank / n + dy[direction];
+    if (x < 0 || y < 0 || x >= n || y >= n) {
+        return false;
+    }
+    int i = y * n + x;
+    uint64_t tile = tiles_at(tiles, i);
+    *moved = (tiles & ~(15ULL << (4 * i))) | tile << (4 * blank);
+    return true;
+}
+
+// the board after walk_length random moves from the goal (fewer, as
+// moves off the board are skipped)
+uint64_t tiles_walk(int n, uint64_t seed, int walk_length) {
+    uint64_t tiles = tiles_goal(n);
+    int blank = n * n - 1;
+    for (int m = 0; m < walk_length; m++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int direction = (seed >> 33) % 4;
+        if (tiles_move(tiles, n, blank, direction, &tiles)) {
+            blank = tiles_blank(tiles, n);
+        }
+    }
+    return tiles;
+}
+
+typedef struct tiles_expansion {
+    uint64_t tiles;
+    int blank;
+    int next_direction;
+} tiles_expansion_t;
+
+// moves tiles into order on an n x n board, each move costing 1
+class sliding_tile_problem {
+    int n;
+    uint64_t goal;
+ public:
+    general_search_problem_t *p;
+    // most nodes alive at once, as of the last expansion
+    int32_t peak_live_nodes;
+
+    sliding_tile_problem(int n) : n(n), p(NULL), peak_live_nodes(0) {
+        goal = tiles_goal(n);
+    }
+    bool is_goal(gen_search_node_t *node) {
+        return (uint64_t)node->state == goal;
+    }
+    float step_cost(gen_search_node_t *node, int32_t action) {
+        return 1;
+    }
+    float ordering_cost(gen_search_node_t *node) {
+        return node->path_cost + tiles_manhattan((uint64_t)node->state, n);
+    }
+    void *expand_state(void *state) {
+        if (p && p->_n_live_nodes > peak_live_nodes) {
+            peak_live_nodes = p->_n_live_nodes;
+        }
+        tiles_expansion_t *expansion =
+                        (tiles_expansion_t*)malloc(sizeof(tiles_expansion_t));
+        expansion->tiles = (uint64_t)state;
+        expansion->blank = tiles_blank(expansion->tiles, n);
+        expansion->next_direction = 0;
+        return expansion;
+    }
+    bool next_new_state(void *expansion,
+                        void **new_state, int32_t *new_action) {
+        tiles_expansion_t *e = (tiles_expansion_t*)expansion;
+        while (e->next_direction < 4) {
+            int d = e->next_direction++;
+            uint64_t moved;
+            if (tiles_move(e->tiles, n, e->blank, d, &moved)) {
+                *new_state = (void*)moved;
+                *new_action = d;
+                return true;
+            }
+        }
+        free(e);
+        return false;
+    }
+    uint64_t calc_state_hash(void *state) {
+        return (uint64_t)state;
+    }
+    uint64_t child_state_hash(uint64_t state_hash, void *state,
+                              void *new_state, int32_t action) {
+        return calc_state_hash(new_state);
+    }
+    void destroy_state(void *state) {
+    }
+    bool should_stop() {
+        return false;
+    }
+};
+
+typedef enum search_mode {
+    MODE_FRONTIER,
+    MODE_IDA_STAR,
+    MODE_RBFS,
+} search_mode_t;
+
+typedef struct search_result {
+    bool found;
+    bool out_of_budget;
+    float path_cost;
+    int32_t expansion_count;
+    int32_t peak_live_nodes;
+    // best of the runs
+    double seconds;
+} search_result_t;
+
+void init_problem(general_search_problem_t *p, void *initial_state,
+                  search_mode_t mode, int32_t node_budget) {
+    memset(p, 0, sizeof(*p));
+    p->initial_state = initial_state;
+    p->use_node_pool = true;
+    p->allow_cycles = false;
+    p->use_ida_star = mode == MODE_IDA_STAR;
+    p->use_rbfs = mode == MODE_RBFS;
+    p->node_budget = node_budget;
+}
+
+// problem's search from initial_state, runs times, each with a new
+// frontier. Frontier is unused by IDA* and RBFS.
+template <class Frontier, class Problem>
+search_result_t run_search(Problem &problem, void *initial_state,
+                           search_mode_t mode, int32_t node_budget,
+                           int runs) {
+    search_result_t result;
+    memset(&result, 0, sizeof(result));
+    for (int run = 0; run < runs; run++) {
+        general_search_problem_t p;
+        init_problem(&p, initial_state, mode, node_budget);
+        problem.p = &p;
+        problem.peak_live_nodes = 0;
+        Frontier frontier;
+        hash_visited_set expanded_set;
+        double start = seconds();
+        gen_search_node_t *goal_node =
+                        tree_search(&p, problem, frontier, expanded_set);
+        double elapsed = seconds() - start;
+
+        if (run == 0 || elapsed < result.seconds) {
+            result.seconds = elapsed;
+        }
+        result.found = goal_node != NULL;
+        result.out_of_budget = p.out_of_budget;
+        result.expansion_count = p.expansion_count;
+        result.peak_live_nodes = problem.peak_live_nodes;
+        if (goal_node) {
+            result.path_cost = goal_node->path_cost;
+            general_search_result_destroy(&p, problem, goal_node);
+        }
+        problem.p = NULL;
+    }
+    return result;
+}
+
+// prints result, returns false if it doesn't have the expected path cost
+bool report(const char *name, search_result_t result,
+            search_result_t expected) {
+    bool agrees = result.found == expected.found &&
+                  (!result.found || result.path_cost == expected.path_cost);
+    printf("  %-14s %8.3f s  cost %7.0f  expanded %8d  peak %8d%s%s\n",
+           name, result.seconds, result.found ? result.path_cost : -1.0f,
+           result.expansion_count, result.peak_live_nodes,
+           result.out_of_budget ? "  out of budget" : "",
+           agrees ? "" : "  MISMATCH");
+    return agrees;
+}
+
+// returns false if the frontiers, and IDA* and RBFS on grids up to
+// SMALL_GRID_MAX, don't all agree
+bool check_grid(int size) {
+    grid_t grid;
+    grid_init(&grid, size, size);
+    grid_problem problem(&grid);
+    void *start = cell_state(0);
+    printf("%dx%d grid, A*, best of %d\n", size, size, RUNS);
+
+    search_result_t expected =
+            run_search<priority_frontier>(problem, start, MODE_FRONTIER, 0,
+                                          RUNS);
+    bool agrees = report("binary_heap", expected, expected);
+    if (!expected.found) {
+        printf("  no path found\n");
+        agrees = false;
+    }
+    agrees &= report("dary_heap", run_search<dary_heap_frontier>(
+                        problem, start, MODE_FRONTIER, 0, RUNS), expected);
+    agrees &= report("bucket", run_search<bucket_frontier>(
+                        problem, start, MODE_FRONTIER, 0, RUNS), expected);
+    agrees &= report("indexed_heap", run_search<indexed_heap_frontier>(
+                        problem, start, MODE_FRONTIER, 0, RUNS), expected);
+    if (size <= SMALL_GRID_MAX) {
+        agrees &= report("ida_star", run_search<priority_frontier>(
+                        problem, start, MODE_IDA_STAR, 0, 1), expected);
+        agrees &= report("rbfs", run_search<priority_frontier>(
+                        problem, start, MODE_RBFS, 0, 1), expected);
+    }
+
+    free(grid.costs);
+    return agrees;
+}
+
+// returns false if tree_search takes indexed_heap_frontier with cycles
+// allowed, when it would merge every node into one (state_hash is 0)
+bool check_indexed_heap_rejects_cycles() {
+    grid_t grid;
+    grid_init(&grid, 2, 2);
+    grid_problem problem(&grid);
+    general_search_problem_t p;
+    init_problem(&p, cell_state(0), MODE_FRONTIER, 0);
+    p.allow_cycles = true;
+    problem.p = &p;
+    indexed_heap_frontier frontier;
+    no_visited_set expanded_set;
+    printf("indexed_heap with cycles allowed (should be an error)\n");
+    fflush(stdout);
+    gen_search_node_t *goal_node =
+                    tree_search(&p, problem, frontier, expanded_set);
+    free(grid.costs);
+    if (goal_node) {
+        printf("  NOT REJECTED\n");
+        general_search_result_destroy(&p, problem, goal_node);
+        return false;
+    }
+    return true;
+}
+
+// Checks IDA* and RBFS against A* on a sliding tile puzzle, a random walk
+// of walk_length moves from the goal, and that a node budget stops A*
+// but not the two that only keep a path.
+// returns false if they don't agree
+bool check_sliding_tiles(int n, uint64_t seed, int walk_length) {
+    uint64_t start = tiles_walk(n, seed, walk_length);
+    sliding_tile_problem problem(n);
+    printf("%dx%d tiles, seed %llu, %d moves, h0 = %d\n",
+           n, n, (unsigned long long)seed, walk_length,
+           tiles_manhattan(start, n));
+
+    search_result_t expected = run_search<priority_frontier>(
+                        problem, (void*)start, MODE_FRONTIER, 0, 1);
+    bool agrees = report("a_star", expected, expected);
+    if (!expected.found) {
+        printf("  no path found\n");
+        agrees = false;
+    }
+    search_mode_t modes[] = { MODE_IDA_STAR, MODE_RBFS };
+    const char *names[] = { "ida_star", "rbfs" };
+    for (int m = 0; m < 2; m++) {
+        agrees &= report(names[m], run_search<priority_frontier>(
+                        problem, (void*)start, modes[m], 0, 1), expected);
+    
+        // the path and the children along it fit well within the budget
+        search_result_t budgeted = run_search<priority_frontier>(
+                problem, (void*)start, modes[m], TILES_PATH_BUDGET, 1);
+        agrees &= report("  with budget", budgeted, expected);
+        agrees &= !budgeted.out_of_budget;
+    }
+
+    // A* keeps every node it has made, so it runs out
+    search_result_t budgeted = run_search<priority_frontier>(
+            problem, (void*)start, MODE_FRONTIER, TILES_PATH_BUDGET, 1);
+    printf("  %-14s %8.3f s  %s\n", "a_star budget", budgeted.seconds,
+           budgeted.out_of_budget ? "out of budget" : "NOT OUT OF BUDGET");
+    agrees &= !budgeted.found && budgeted.out_of_budget;
+    return agrees;
+}
+
+int main(int argc, char **argv) {
+    bool agrees = true;
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            int size = atoi(argv[i]);
+            if (size < 1) {
+                fprintf(stderr, "Grid size must be positive, not %s\n",
+                        argv[i]);
+                return 1;
+            }
+            agrees &= check_grid(size);
+        }
+    } else {
+        int sizes[] = DEFAULT_SIZES;
+        for (int size : sizes) {
+            agrees &= check_grid(size);
+        }
+        uint64_t seeds[] = TILES_SEEDS;
+        for (uint64_t seed : seeds) {
+            agrees &= check_sliding_tiles(4, seed, TILES_WALK_LENGTH);
+        }
+        agrees &= check_indexed_heap_rejects_cycles();
+    }
+    if (!agrees) {
+        fprintf(stderr, "The searches didn't all check out\n");
+        return 1;
+    }
+    return 0;
+}
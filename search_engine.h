@@ -0,0 +1,522 @@
+#pragma once
+
+// Header-only tree_search, specialized at compile time on the problem,
+// the frontier, and the expanded-state set so that every call on the hot
+// path can be inlined. Options and counters still live in a
+// general_search_problem_t, but its function pointers are not used here.
+// The tree_search(general_search_problem_t*) in general_search.cpp is
+// an adapter that instantiates this with the function pointers.
+//
+// Problem must provide:
+//   bool is_goal(gen_search_node_t *node);
+//   float step_cost(gen_search_node_t *node, int32_t action);
+//   float ordering_cost(gen_search_node_t *node);
+//   void *expand_state(void *state);
+//   bool next_new_state(void *expansion,
+//                       void **new_state, int32_t *new_action);
+//   uint64_t calc_state_hash(void *state);
+//   // the hash of new_state, which came from state (hashing to
+//   // state_hash) by action. Only called when cycles aren't allowed.
+//   uint64_t child_state_hash(uint64_t state_hash, void *state,
+//                             void *new_state, int32_t action);
+//   void destroy_state(void *state);
+//   bool should_stop();
+// Frontier must provide (see frontiers.h):
+//   bool empty();
+//   // returns a node to delete that it dropped in favor of another
+//   // for the same state, or NULL
+//   gen_search_node_t *push(gen_search_node_t *node);
+//   gen_search_node_t *pop();  // NULL when empty
+// A Frontier that keeps nodes by state_hash specializes
+// frontier_uses_state_hash to true, so searches that don't keep it
+// (allow_cycles) are turned away.
+// VisitedSet must provide (see visited_sets.h), used unless allow_cycles:
+//   void clear();
+//   void reserve(size_t n);
+//   void add(uint64_t hash);
+//   bool contains(uint64_t hash);
+
+#include "general_search.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+template <class Frontier>
+struct frontier_uses_state_hash {
+    static const bool value = false;
+};
+
+template <class Problem>
+gen_search_node_t *make_node(general_search_problem_t *p, Problem &problem,
+                             gen_search_node_t *parent,
+                             void *state, int32_t action,
+                             uint64_t state_hash) {
+    gen_search_node_t *node;
+    if (p->use_node_pool) {
+        // every field is set below
+        node = (gen_search_node_t*)pool_alloc(&p->_node_pool);
+    } else {
+        node = (gen_search_node_t*)calloc(1, sizeof(gen_search_node_t));
+    }
+    node->state = state;
+    node->parent = parent;
+    node->action = action;
+    node->depth = parent ? parent->depth + 1 : 0;
+    node->path_cost = parent ?
+                (parent->path_cost + problem.step_cost(node, action)) : 0;
+    node->ordering_cost = problem.ordering_cost(node);
+    node->n_alive_children = 0;
+    node->state_hash = state_hash;
+    p->_n_live_nodes++;
+    if (parent) {
+        parent->n_alive_children++;
+    }
+    return node;
+}
+
+template <class Problem>
+void delete_node(general_search_problem_t *p, Problem &problem,
+                 gen_search_node_t *node) {
+    gen_search_node_t *parent = node->parent;
+    if (parent) {
+        problem.destroy_state(node->state);
+    }
+    if (p->use_node_pool) {
+        pool_free(&p->_node_pool, node);
+    } else {
+        free(node);
+    }
+    p->_n_live_nodes--;
+    if (parent) {
+        parent->n_alive_children--;
+        if (parent->n_alive_children == 0) {
+            delete_node(p, problem, parent);
+        }
+    }
+}
+
+template <class Problem, class Frontier>
+void clear_frontier(general_search_problem_t *p, Problem &problem,
+                    Frontier &frontier) {
+    gen_search_node_t *node = NULL;
+    while ((node = frontier.pop())) {
+        delete_node(p, problem, node);
+    }
+}
+
+template <class Problem>
+void general_search_result_destroy(general_search_problem_t *p,
+                                   Problem &problem,
+                                   gen_search_node_t *result) {
+    delete_node(p, problem, result);
+    if (p->use_node_pool) {
+        pool_destroy(&p->_node_pool);
+    }
+}
+
+// Checks the options of the problem that both versions use
+inline bool check_search_options(general_search_problem_t *p) {
+    if (p->use_iterative_depth + p->use_ida_star + p->use_rbfs > 1) {
+        fprintf(stderr, "Error: Problem can use at most one of "
+                        "iterative depth, IDA*, and RBFS\n");
+        return false;
+    }
+    if (p->use_iterative_depth && p->iterative_depth_init < 0) {
+        fprintf(stderr,
+            "Error: Problem iterative_depth_init must be non-negative\n");
+        return false;
+    }
+    if (p->use_iterative_depth && p->iterative_depth_increment < 0) {
+        fprintf(stderr,
+            "Error: Problem iterative_depth_increment must be non-negative\n");
+        return false;
+    }
+    if (!p->initial_state) {
+        fprintf(stderr, "Error: Problem missing necessary initial_state\n");
+        return false;
+    }
+    return true;
+}
+
+// Checks that frontier can be used with p's options
+template <class Frontier>
+bool check_frontier_options(general_search_problem_t *p) {
+    bool uses_frontier = !p->use_ida_star && !p->use_rbfs;
+    if (uses_frontier && p->allow_cycles &&
+            frontier_uses_state_hash<Frontier>::value) {
+        fprintf(stderr, "Error: Frontier keeps nodes by state_hash, "
+                        "which isn't kept when cycles are allowed\n");
+        return false;
+    }
+    return true;
+}
+
+// true once more than p->node_budget nodes are alive
+inline bool over_node_budget(general_search_problem_t *p) {
+    if (p->node_budget > 0 && p->_n_live_nodes > p->node_budget) {
+        p->out_of_budget = true;
+        return true;
+    }
+    return false;
+}
+
+// for the searches that only keep the current path, where checking it
+// stands in for the expanded-state set
+inline bool is_on_path(gen_search_node_t *node, uint64_t state_hash) {
+    for (; node; node = node->parent) {
+        if (node->state_hash == state_hash) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The children of node, made as nodes, unless they repeat a state on
+// node's path when cycles aren't allowed.
+// Holds node alive (see inner_tree_search) until release_children.
+template <class Problem>
+void make_children(general_search_problem_t *p, Problem &problem,
+                   gen_search_node_t *node,
+                   std::vector<gen_search_node_t*> *children) {
+    node->n_alive_children++;
+    void *expansion = problem.expand_state(node->state);
+    void *new_state = NULL;
+    int32_t new_action = -1;
+    while (problem.next_new_state(expansion, &new_state, &new_action)) {
+        uint64_t new_hash = 0;
+        if (!p->allow_cycles) {
+            new_hash = problem.child_state_hash(node->state_hash,
+                                                node->state, new_state,
+                                                new_action);
+            if (is_on_path(node, new_hash)) {
+                problem.destroy_state(new_state);
+                continue;
+            }
+        }
+        children->push_back(make_node(p, problem, node, new_state,
+                                      new_action, new_hash));
+    }
+}
+
+// deletes every child of node but keep (which may be NULL), and lets go
+// of node's hold from make_children
+template <class Problem>
+void release_children(general_search_problem_t *p, Problem &problem,
+                      gen_search_node_t *node,
+                      std::vector<gen_search_node_t*> &children,
+                      gen_search_node_t *keep) {
+    for (size_t k = 0; k < children.size(); k++) {
+        if (children[k] != keep) {
+            delete_node(p, problem, children[k]);
+        }
+    }
+    node->n_alive_children--;
+}
+
+// One pass of ida_star below node.
+// returns the goal node, or NULL after lowering *next_threshold to the
+// least ordering_cost it cut off
+template <class Problem>
+gen_search_node_t *ida_star_pass(general_search_problem_t *p,
+                                 Problem &problem, gen_search_node_t *node,
+                                 float threshold, float *next_threshold) {
+    if (node->ordering_cost > threshold) {
+        if (node->ordering_cost < *next_threshold) {
+            *next_threshold = node->ordering_cost;
+        }
+        return NULL;
+    }
+    if (problem.should_stop() || over_node_budget(p)) {
+        return NULL;
+    }
+    p->expansion_count++;
+    if (problem.is_goal(node)) {
+        return node;
+    }
+
+    // children are made one at a time, keeping memory to the path
+    node->n_alive_children++;
+    gen_search_node_t *goal = NULL;
+    void *expansion = problem.expand_state(node->state);
+    void *new_state = NULL;
+    int32_t new_action = -1;
+    while (problem.next_new_state(expansion, &new_state, &new_action)) {
+        // the rest of the expansion still has to run out, for its cleanup
+        if (goal) {
+            problem.destroy_state(new_state);
+            continue;
+        }
+        uint64_t new_hash = 0;
+        if (!p->allow_cycles) {
+            new_hash = problem.child_state_hash(node->state_hash,
+                                                node->state, new_state,
+                                                new_action);
+            if (is_on_path(node, new_hash)) {
+                problem.destroy_state(new_state);
+                continue;
+            }
+        }
+        gen_search_node_t *child = make_node(p, problem, node, new_state,
+                                             new_action, new_hash);
+        goal = ida_star_pass(p, problem, child, threshold, next_threshold);
+        if (!goal) {
+            delete_node(p, problem, child);
+        }
+    }
+    node->n_alive_children--;
+    return goal;
+}
+
+template <class Problem>
+gen_search_node_t *ida_star(general_search_problem_t *p, Problem &problem) {
+    uint64_t initial_hash = 0;
+    if (!p->allow_cycles) {
+        initial_hash = problem.calc_state_hash(p->initial_state);
+    }
+    float threshold = -INFINITY;
+    while (1) {
+        gen_search_node_t *root = make_node(p, problem, NULL,
+                                            p->initial_state, 0,
+                                            initial_hash);
+        if (threshold == -INFINITY) {
+            threshold = root->ordering_cost;
+        }
+        float next_threshold = INFINITY;
+        gen_search_node_t *goal = ida_star_pass(p, problem, root,
+                                                threshold, &next_threshold);
+        if (goal) {
+            return goal;
+        }
+        delete_node(p, problem, root);
+        if (next_threshold == INFINITY || problem.should_stop() ||
+                p->out_of_budget) {
+            return NULL;
+        }
+        threshold = next_threshold;
+        if (p->debugging) {
+            printf("Increasing IDA* threshold to %.2f\n", threshold);
+        }
+    }
+}
+
+// Searches below node, whose backed-up f-cost is node_f, until every
+// path left costs more than f_limit.
+// returns the goal node, or NULL with *backed_up_f set to the least
+// f-cost left below node
+template <class Problem>
+gen_search_node_t *rbfs_visit(general_search_problem_t *p, Problem &problem,
+                              gen_search_node_t *node, float node_f,
+                              float f_limit, float *backed_up_f) {
+    *backed_up_f = INFINITY;
+    if (problem.should_stop() || over_node_budget(p)) {
+        return NULL;
+    }
+    p->expansion_count++;
+    if (problem.is_goal(node)) {
+        return node;
+    }
+
+    std::vector<gen_search_node_t*> children;
+    make_children(p, problem, node, &children);
+    // a child's f-cost can't be less than its parent's (pathmax), as
+    // node_f may already be backed up from an earlier visit
+    std::vector<float> child_f(children.size());
+    for (size_t k = 0; k < children.size(); k++) {
+        child_f[k] = fmaxf(children[k]->ordering_cost, node_f);
+    }
+
+    gen_search_node_t *goal = NULL;
+    gen_search_node_t *goal_child = NULL;
+    while (!children.empty()) {
+        size_t best = 0;
+        for (size_t k = 1; k < children.size(); k++) {
+            if (child_f[k] < child_f[best]) {
+                best = k;
+            }
+        }
+        if (child_f[best] > f_limit || child_f[best] == INFINITY) {
+            *backed_up_f = child_f[best];
+            break;
+        }
+        float alternative = INFINITY;
+        for (size_t k = 0; k < children.size(); k++) {
+            if (k != best && child_f[k] < alternative) {
+                alternative = child_f[k];
+            }
+        }
+        goal = rbfs_visit(p, problem, children[best], child_f[best],
+                          fminf(f_limit, alternative), &child_f[best]);
+        if (goal) {
+            goal_child = children[best];
+            break;
+        }
+        if (problem.should_stop() || p->out_of_budget) {
+            break;
+        }
+    }
+    release_children(p, problem, node, children, goal_child);
+    return goal;
+}
+
+template <class Problem>
+gen_search_node_t *rbfs(general_search_problem_t *p, Problem &problem) {
+    uint64_t initial_hash = 0;
+    if (!p->allow_cycles) {
+        initial_hash = problem.calc_state_hash(p->initial_state);
+    }
+    gen_search_node_t *root = make_node(p, problem, NULL, p->initial_state,
+                                        0, initial_hash);
+    float backed_up_f;
+    gen_search_node_t *goal = rbfs_visit(p, problem, root,
+                                         root->ordering_cost, INFINITY,
+                                         &backed_up_f);
+    if (!goal) {
+        delete_node(p, problem, root);
+    }
+    return goal;
+}
+
+template <class Problem, class Frontier, class VisitedSet>
+gen_search_node_t *inner_tree_search(general_search_problem_t *p,
+                                     Problem &problem, Frontier &frontier,
+                                     VisitedSet &expanded_set,
+                                     bool *needs_depth_increase) {
+    uint64_t initial_hash = 0;
+    if (!p->allow_cycles) {
+        expanded_set.clear();
+        if (p->expected_state_count > 0) {
+            expanded_set.reserve(p->expected_state_count);
+        }
+        initial_hash = problem.calc_state_hash(p->initial_state);
+    }
+    frontier.push(make_node(p, problem, NULL, p->initial_state, 0,
+                            initial_hash));
+
+    while (1) {
+        if (frontier.empty() || problem.should_stop() ||
+                over_node_budget(p)) {
+            clear_frontier(p, problem, frontier);
+            return NULL;
+        }
+
+        gen_search_node_t *node = frontier.pop();
+
+        if (!p->allow_cycles) {
+            if (expanded_set.contains(node->state_hash)) {
+                // already expanded
+                delete_node(p, problem, node);
+                continue;
+            }
+        }
+
+        if (p->debugging) {
+            printf("Expanding node with path_cost: %.2f depth: %d ",
+                    node->path_cost, node->depth);
+        }
+        p->expansion_count++;
+
+        if (problem.is_goal(node)) {
+            clear_frontier(p, problem, frontier);
+            if (p->debugging) {
+                printf("\n");
+            }
+            return node;
+        }
+
+        if (p->use_iterative_depth &&
+                node->depth >= p->_iterative_depth_limit) {
+            delete_node(p, problem, node);
+            if (p->iterative_depth_increment > 0) {
+                *needs_depth_increase = true;
+            }
+            if (p->debugging) {
+                printf("\n");
+            }
+            continue;
+        }
+
+        void *expansion = problem.expand_state(node->state);
+        if (!p->allow_cycles) {
+            expanded_set.add(node->state_hash);
+        }
+
+        // keeps node alive while its children are made, since deleting a
+        // child the frontier drops would otherwise delete node with it
+        node->n_alive_children++;
+        void *new_state = NULL;
+        int32_t new_action = -1;
+        while (problem.next_new_state(expansion, &new_state, &new_action)) {
+            uint64_t new_hash = 0;
+            if (!p->allow_cycles) {
+                new_hash = problem.child_state_hash(node->state_hash,
+                                                    node->state, new_state,
+                                                    new_action);
+                if (expanded_set.contains(new_hash)) {
+                    problem.destroy_state(new_state);
+                    continue;
+                }
+            }
+            gen_search_node_t *new_node = make_node(p, problem, node,
+                                                    new_state, new_action,
+                                                    new_hash);
+            gen_search_node_t *dropped = frontier.push(new_node);
+            if (dropped) {
+                delete_node(p, problem, dropped);
+            }
+        }
+        node->n_alive_children--;
+        if (node->n_alive_children == 0) {
+            // leaf node will be forgotten
+            delete_node(p, problem, node);
+        }
+
+        if (p->debugging) {
+            printf("\n");
+        }
+    }
+}
+
+template <class Problem, class Frontier, class VisitedSet>
+gen_search_node_t *tree_search(general_search_problem_t *p, Problem &problem,
+                               Frontier &frontier, VisitedSet &expanded_set) {
+    if (!check_search_options(p) || !check_frontier_options<Frontier>(p)) {
+        return NULL;
+    }
+    p->_iterative_depth_limit = p->iterative_depth_init;
+    p->_n_live_nodes = 0;
+    p->out_of_budget = false;
+    if (p->use_node_pool) {
+        pool_init(&p->_node_pool, sizeof(gen_search_node_t));
+    }
+
+    if (p->use_ida_star || p->use_rbfs) {
+        gen_search_node_t *result = p->use_ida_star ? ida_star(p, problem) :
+                                                      rbfs(p, problem);
+        if (!result && p->use_node_pool) {
+            pool_destroy(&p->_node_pool);
+        }
+        return result;
+    }
+
+    int32_t depth_max = p->iterative_depth_max > 0 ?
+                            p->iterative_depth_max : 500;
+    bool needs_depth_increase = false;
+    gen_search_node_t *result = inner_tree_search(
+                    p, problem, frontier, expanded_set, &needs_depth_increase);
+    while (!result && needs_depth_increase &&
+            p->_iterative_depth_limit < depth_max &&
+            !problem.should_stop() && !p->out_of_budget) {
+        p->_iterative_depth_limit += p->iterative_depth_increment;
+        printf("Increasing iterative-depth limit to %d\n",
+                p->_iterative_depth_limit);
+        result = inner_tree_search(
+                    p, problem, frontier, expanded_set, &needs_depth_increase);
+    }
+
+    if (!result && p->use_node_pool) {
+        pool_destroy(&p->_node_pool);
+    }
+    return result;
+}
@@ -1,4 +1,6 @@
 #include "sudoku.h"
+#include "sudoku_simd.h"
+#include "sudoku_tables.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,8 +8,15 @@
 #include <math.h>
 #include <limits.h>
 #include <time.h>
+#include <unistd.h>
+#include <getopt.h>
 
-#define BITS_1_9_SET ((1 << 10) - 1) & (~(uint16_t)1)
+// ENGINE_AUTO uses dancing links when propagating the clues leaves at
+// least this many cells open. Those are the puzzles with long searches,
+// where DLX's cheaper steps win, more so when counting has to go through
+// the whole tree. Measured on puzzles/*.txt and puzzles with clues removed.
+#define AUTO_DLX_MIN_OPEN 62
+#define AUTO_DLX_MIN_OPEN_COUNTING 50
 
 double seconds() {
     struct timespec now;
@@ -20,29 +29,15 @@ double seconds() {
 
 void read_board(char *board) {
     FILE *f = fopen("suinput.csv", "r");
+    if (!f) {
+        fprintf(stderr, "Could not open suinput.csv\n");
+        exit(1);
+    }
 
-    int val_on = 0;
     int line_on = 0;
-    while (val_on < 81) {
-        int c = fgetc(f);
-        if (c == EOF) {
-            fprintf(stderr, "Unexpected EOF in suinput.csv "
-                            "after reading %d values\n", val_on);
-            exit(1);
-        }
-        if (c == ',' || c == '\r') {
-            continue;
-        }
-        if (c == '\n') {
-            line_on++;
-            continue;
-        }
-        if (c < '0' || c > '9') {
-            fprintf(stderr, "Unexpected character '%c' on line %d\n",
-                            c, line_on);
-            exit(1);
-        }
-        board[val_on++] = c - '0';
+    if (!read_puzzle(f, board, &line_on)) {
+        fprintf(stderr, "Unexpected EOF in suinput.csv before any values\n");
+        exit(1);
     }
 
     fclose(f);
@@ -66,42 +61,26 @@ void print_board(char *board) {
     fclose(f);
 }
 
-bool check_add_fails(char *board, int i, int number) {
-    // check row, col, and square to see if this add makes sense
-    // consider neighbors in same row, column, and 3x3
-    int row = i / 9;
-    int col = i % 9;
-
-    int j = row * 9;
-    for (int col_j = 0; col_j < 9; col_j++, j++) {
-        if (j != i && board[j] == number) {
-            return true;
-        }
-    }
-
-    j = col;
-    for (int row_j = 0; row_j < 9; row_j++, j += 9) {
-        if (j != i && board[j] == number) {
+// True if a peer of unsolved cell i (same row, column, or 3x3) already
+// holds number, which must still be in cell i's domain. A solved peer that
+// run_ac3 has processed would have taken number out of that domain, so only
+// the peers still waiting in needs_reprocessing can, and there are usually
+// none of those.
+bool check_add_fails(char *board, uint64_t *needs_reprocessing,
+                     int i, int number) {
+    uint64_t waiting[2] = { TABLES.peer_bits[i][0] & needs_reprocessing[0],
+                            TABLES.peer_bits[i][1] & needs_reprocessing[1] };
+    while (waiting[0] || waiting[1]) {
+        if (board[reprocessing_pop(waiting)] == number) {
             return true;
         }
     }
-
-    int row_three = (row / 3) * 3;
-    int col_three = (col / 3) * 3;
-    j = row_three * 9 + col_three;
-    for (int row_j = 0; row_j < 3; row_j++, j += 9) {
-        for (int col_j = 0; col_j < 3; col_j++) {
-            if (j != i && board[j] == number) {
-                return true;
-            }
-        }
-    }
-
     return false;
 }
 
-void check_add(char *board, int i, int number) {
-    if (check_add_fails(board, i, number)) {
+void check_add(char *board, uint64_t *needs_reprocessing,
+               int i, int number) {
+    if (check_add_fails(board, needs_reprocessing, i, number)) {
         printf("Error! Tried to make invalid board by "
                "adding %d at row %d col %d\n", number, i / 9, i % 9);
         print_board(board);
@@ -114,54 +93,16 @@ void check_add(char *board, int i, int number) {
 // column, row, and 3x3 square so that they cannot be this known value.
 // returns true if ran normally, false if incountered an inconsistent board
 bool run_ac3(char *board, uint16_t *board_domain,
-             uint64_t *needs_reprocessing) {
+             uint64_t *needs_reprocessing, trail_t *trail) {
     while (needs_reprocessing[0] || needs_reprocessing[1]) {
         int i = reprocessing_pop(needs_reprocessing);
+        STATS_ADD(ac3_pops, 1);
 
-        uint16_t mask_i = board_domain[i];
-        int row = i / 9;
-        int col = i % 9;
-
-        int neighbors[27] = { 0 };
-        int neighbor_i = 0;
-        // consider neighbors in same row, column, and 3x3
-        int j = row * 9;
-        for (int col_j = 0; col_j < 9; col_j++, j++) {
-            neighbors[neighbor_i++] = j;
-        }
-
-        j = col;
-        for (int row_j = 0; row_j < 9; row_j++, j += 9) {
-            neighbors[neighbor_i++] = j;
-        }
-
-        int row_three = (row / 3) * 3;
-        int col_three = (col / 3) * 3;
-        j = row_three * 9 + col_three;
-        for (int row_j = 0; row_j < 3; row_j++, j += 9) {
-            for (int col_j = 0; col_j < 3; col_j++) {
-                neighbors[neighbor_i++] = j + col_j;
-            }
-        }
-
-        // process all neighbors
-        for (int n_i = 0; n_i < 27; n_i++) {
-            j = neighbors[n_i];
-            if (j == i || board[j] != 0) {
-                continue;
-            }
-            board_domain[j] &= ~mask_i;
-            if (count_on_bits(board_domain[j]) == 1) {
-                int number = which_on_bit(board_domain[j]);
-                if (check_add_fails(board, j, number)) {
-                    // inconsistent -- we're done
-                    // printf("Ending ac3 early with inconsistent board\n");
-                    return false;
-                }
-                // printf("Added %d at row %d col %d\n", number, i / 9, i % 9);
-                board[j] = number;
-                reprocessing_insert(needs_reprocessing, j);
-            }
+        // process all neighbors in same row, column, and 3x3
+        if (!eliminate_from_peers(board, board_domain,
+                                  needs_reprocessing, i, trail)) {
+            // inconsistent -- we're done
+            return false;
         }
     }
     return true;
@@ -170,19 +111,14 @@ bool run_ac3(char *board, uint16_t *board_domain,
 // check for spots that are the only one that can take a given value
 // So if a cell has domain [2, 3, 4, 5, 6], but no other cell has 6
 // in the domain, this cell must be 6!
+// has_single_set_bit holds the values only one cell in the section can take,
+// as found by find_hidden_singles.
 // returns true if ran normally, false if incountered an inconsistent board
 bool run_only_viable_for_section(char *board, uint16_t *board_domain,
-                                 uint64_t *needs_reprocessing, int *section) {
-    uint16_t has_any_set_bits = 0;
-    uint16_t has_multiple_set_bits = 0;
-    for (int section_i = 0; section_i < 9; section_i++) {
-        int i = section[section_i];
-        if (board[i] == 0) {
-            has_multiple_set_bits |= has_any_set_bits & board_domain[i];
-            has_any_set_bits |= board_domain[i];
-        }
-    }
-    uint16_t has_single_set_bit = has_any_set_bits & ~has_multiple_set_bits;
+                                 uint64_t *needs_reprocessing,
+                                 const uint8_t *section,
+                                 uint16_t has_single_set_bit,
+                                 trail_t *trail) {
     while (has_single_set_bit) {
         int num = which_on_bit(has_single_set_bit);
         has_single_set_bit &= ~(1 << num);  // clear bit
@@ -192,13 +128,17 @@ bool run_only_viable_for_section(char *board, uint16_t *board_domain,
         for (int section_i = 0; section_i < 9; section_i++) {
             int i = section[section_i];
             if (board[i] == 0 && (num_mask & board_domain[i])) {
-                check_add(board, i, num);
+                check_add(board, needs_reprocessing, i, num);
+                STATS_ADD(hidden_singles, 1);
+                trail_save(trail, board, board_domain, i);
                 board[i] = num;
                 board_domain[i] = 1 << board[i];
+                sections_mark_dirty(needs_reprocessing,
+                                    TABLES.cell_section_bits[i]);
                 if (!reprocessing_contains(needs_reprocessing, i)) {
                     reprocessing_insert(needs_reprocessing, i);
                     bool normal = run_ac3(board, board_domain,
-                                          needs_reprocessing);
+                                          needs_reprocessing, trail);
                     if (!normal) {
                         return false;
                     }
@@ -209,16 +149,49 @@ bool run_only_viable_for_section(char *board, uint16_t *board_domain,
     return true;
 }
 
+// below this many dirty sections, each is scanned on its own
+// rather than all 27 at once by find_hidden_singles
+#define HIDDEN_SINGLES_FULL_SCAN 10
+
+// Only the sections marked dirty since the last pass can have new hidden
+// singles. Their singles are found up front, so placements in one section
+// can reveal new ones elsewhere. Repeats until no section is left dirty.
 bool run_only_viable(char *board, uint16_t *board_domain,
-                     uint64_t *needs_reprocessing, int *all_sections) {
-    int *section = all_sections;
-    for (int section_i = 0; section_i < 27; section_i++) {
-        bool normal = run_only_viable_for_section(board, board_domain,
-                                                  needs_reprocessing, section);
+                     uint64_t *needs_reprocessing, trail_t *trail) {
+    uint32_t dirty;
+    while ((dirty = sections_take_dirty(needs_reprocessing,
+                                        SECTIONS_HIDDEN_SHIFT))) {
+        uint16_t singles[27];
+        bool normal = true;
+        if (__builtin_popcount(dirty) >= HIDDEN_SINGLES_FULL_SCAN) {
+            normal = find_hidden_singles(board, board_domain, singles);
+        } else {
+            for (uint32_t d = dirty; d; d &= d - 1) {
+                int section_i = __builtin_ctz(d);
+                normal &= find_hidden_singles_for_section(
+                            board, board_domain, TABLES.sections[section_i],
+                            &singles[section_i]);
+            }
+        }
         if (!normal) {
+            // a value with no place left in some section
             return false;
         }
-        section += 9;
+
+        while (dirty) {
+            int section_i = __builtin_ctz(dirty);
+            dirty &= dirty - 1;
+            if (!singles[section_i]) {
+                continue;
+            }
+            normal = run_only_viable_for_section(
+                            board, board_domain, needs_reprocessing,
+                            TABLES.sections[section_i], singles[section_i],
+                            trail);
+            if (!normal) {
+                return false;
+            }
+        }
     }
     return true;
 }
@@ -228,12 +201,12 @@ bool run_only_viable(char *board, uint16_t *board_domain,
 // for example, three cells have domains [2, 3, 4], [2, 3], [2, 3]
 // we find exactly two cells with [2, 3], meaning that the others should
 // have this removed from their domains. So the first cell's domain is [4].
-// returns true if it made any change to the board_domain
+// Sets *made_change if it made any change to the board_domain.
+// returns false if a cell is left with nothing, a board that can't be solved
 bool run_n_domain_reduction_for_section(
         char *board, uint16_t *board_domain,
-        uint64_t *needs_reprocessing, int *section) {
-    bool made_change = false;
-
+        uint64_t *needs_reprocessing, const uint8_t *section,
+        trail_t *trail, bool *made_change) {
     // which elements of the section still to look at, bitmask
     uint16_t needs_examination = (1 << 9) - 1;
     for (int section_i = 0; section_i < 9; section_i++) {
@@ -277,98 +250,129 @@ bool run_n_domain_reduction_for_section(
             if (new_board_domain == board_domain[i]) {
                 continue;
             }
+            trail_save(trail, board, board_domain, i);
             board_domain[i] = new_board_domain;
-
-            made_change = true;
+            sections_mark_dirty(needs_reprocessing,
+                                TABLES.cell_section_bits[i]);
+            STATS_ADD(subset_reductions, 1);
+
+            *made_change = true;
+            if (new_board_domain == 0) {
+                // a domain inside the subset's, but smaller
+                return false;
+            }
         }
     }
 
-    return made_change;
+    return true;
 }
 
-// returns true if any changes are made to board_domain
+// Looks only at the sections marked dirty since it last ran.
+// Sets *made_change if any changes are made to board_domain.
+// returns false if the board is left inconsistent
 bool run_n_domain_reduction(char *board, uint16_t *board_domain,
-                     uint64_t *needs_reprocessing, int *all_sections) {
-    bool made_change = false;
-
-    int *section = all_sections;
-    for (int section_i = 0; section_i < 27; section_i++) {
-        bool change = run_n_domain_reduction_for_section(
-                        board, board_domain, needs_reprocessing, section);
-        made_change = made_change || change;
-        section += 9;
-    }
-
-    return made_change;
-}
-
-int *get_all_sections() {
-    static bool needs_init = true;
-    static int all_sections[27*9];
-
-    if (!needs_init) {
-        return all_sections;
-    }
-    needs_init = false;
-
-    int *section = all_sections;
-
-    // check for spots that are the only one that can take a given value
-    // by row
-    for (int row = 0; row < 9; row++) {
-        int i = row * 9;
-        for (int col = 0; col < 9; col++, i++) {
-            section[col] = i;
-        }
-        section += 9;
-    }
-
-    for (int col = 0; col < 9; col++) {
-        int i = col;
-        for (int row = 0; row < 9; row++, i += 9) {
-            section[row] = i;
-        }
-        section += 9;
-    }
-
-    for (int row_three = 0; row_three < 9; row_three += 3) {
-        for (int col_three = 0; col_three < 9; col_three += 3) {
-            int i = row_three * 9 + col_three;
-            int section_i = 0;
-            for (int row = 0; row < 3; row++, i += 9) {
-                for (int col = 0; col < 3; col++) {
-                    section[section_i++] = i + col;
-                }
-            }
-            section += 9;
+                            uint64_t *needs_reprocessing, trail_t *trail,
+                            bool *made_change) {
+    uint32_t dirty = sections_take_dirty(needs_reprocessing,
+                                         SECTIONS_SUBSET_SHIFT);
+    while (dirty) {
+        int section_i = __builtin_ctz(dirty);
+        dirty &= dirty - 1;
+        bool normal = run_n_domain_reduction_for_section(
+                        board, board_domain, needs_reprocessing,
+                        TABLES.sections[section_i], trail, made_change);
+        if (!normal) {
+            return false;
         }
     }
-
-    return all_sections;
+    return true;
 }
 
-// returns true if board is valid, false if inconsistent
+// returns true if board is valid, false if inconsistent. Every rule
+// reports the domains it empties, so no scan of the board is needed after.
+// Every change is saved on trail first, if one is given.
+// rules (PROPAGATE_*) adds the rules of run_extra_rules, which only run
+// once the basic ones have nothing left to do.
 bool run_constraint_update(char *board, uint16_t *board_domain,
-                           uint64_t *needs_reprocessing, int *all_sections) {
-    bool normal = run_ac3(board, board_domain, needs_reprocessing);
+                           uint64_t *needs_reprocessing, trail_t *trail,
+                           uint32_t rules) {
+    STATS_TIMER(ac3_start);
+    bool normal = run_ac3(board, board_domain, needs_reprocessing, trail);
+    STATS_TIME(ac3_start, ac3_seconds);
     if (!normal) {
         return false;
     }
+    bool reduced;
     do {
+        STATS_TIMER(only_viable_start);
         normal = run_only_viable(board, board_domain,
-                                 needs_reprocessing, all_sections);
+                                 needs_reprocessing, trail);
+        STATS_TIME(only_viable_start, hidden_single_seconds);
+        if (!normal) {
+            return false;
+        }
+        STATS_TIMER(reduction_start);
+        reduced = false;
+        normal = run_n_domain_reduction(board, board_domain,
+                                        needs_reprocessing, trail, &reduced);
+        STATS_TIME(reduction_start, subset_seconds);
         if (!normal) {
             return false;
         }
-    } while (run_n_domain_reduction(
-                    board, board_domain, needs_reprocessing, all_sections));
-    return is_board_solveable(board, board_domain);
+        if (!reduced && rules) {
+            if (!run_extra_rules(board, board_domain, needs_reprocessing,
+                                 trail, rules, &reduced)) {
+                return false;
+            }
+        }
+    } while (reduced);
+    return true;
+}
+
+void trail_init(trail_t *trail) {
+    trail->size = 0;
+    // one entry per possible domain change of every cell is enough
+    // for most whole searches
+    trail->capacity = 81 * 9;
+    trail->entries = (trail_entry_t*)malloc(
+                        trail->capacity * sizeof(trail_entry_t));
+}
+
+void trail_destroy(trail_t *trail) {
+    free(trail->entries);
+    trail->entries = NULL;
+    trail->size = 0;
+    trail->capacity = 0;
+}
+
+void trail_grow(trail_t *trail) {
+    trail->capacity *= 2;
+    trail->entries = (trail_entry_t*)realloc(
+                        trail->entries,
+                        trail->capacity * sizeof(trail_entry_t));
+    if (!trail->entries) {
+        fprintf(stderr, "Fatal Error: failed to grow the trail to %d\n",
+                trail->capacity);
+        exit(1);
+    }
+}
+
+// restores every cell saved since the trail was at size
+void trail_undo(trail_t *trail, int size,
+                char *board, uint16_t *board_domain) {
+    while (trail->size > size) {
+        trail_entry_t *entry = &trail->entries[--trail->size];
+        board[entry->i] = entry->board;
+        board_domain[entry->i] = entry->board_domain;
+    }
 }
 
-void solve(char *board, bool debug) {
+// fills in board_domain for the clues of board, and propagates them
+// with the basic rules and those of rules (PROPAGATE_*)
+// returns false if the clues are inconsistent
+bool propagate_clues(char *board, uint16_t *board_domain, uint32_t rules) {
     // we will use a bitmask to represent the domain of each cell
     // bit-1 is "1", bit-2 is "2", and so forth... bit-0 is unused.
-    uint16_t board_domain[81];
     for (int i = 0; i < 81; i++) {
         if (board[i] != 0) {
             board_domain[i] = 1 << board[i];
@@ -378,30 +382,441 @@ void solve(char *board, bool debug) {
         }
     }
 
-    // there are 27 different sections which must all have 1-9 once each.
-    int *all_sections = get_all_sections();
-
     // Bitmask. again, bit-0 indicates cell 0, and so forth
     // Split over two 64-bit ints to get at least 81 bits.
-    uint64_t needs_reprocessing[2] = { 0, 0 };
+    // Nothing has been looked at yet, so every section starts dirty.
+    uint64_t needs_reprocessing[REPROCESSING_WORDS] = { 0 };
+    sections_mark_dirty(needs_reprocessing, ALL_SECTIONS);
+    // the digits placed so far in each section, by TABLES.sections index
+    uint16_t placed[27] = { 0 };
     for (int i = 0; i < 81; i++) {
         if (board[i] == 0) {
             continue;
         }
+        // clues that already conflict would otherwise send the search
+        // through the entire tree before giving up
+        uint16_t digit = 1 << board[i];
+        const uint8_t *sections = TABLES.cell_sections[i];
+        if ((placed[sections[0]] | placed[sections[1]] |
+                placed[sections[2]]) & digit) {
+            return false;
+        }
+        placed[sections[0]] |= digit;
+        placed[sections[1]] |= digit;
+        placed[sections[2]] |= digit;
         reprocessing_insert(needs_reprocessing, i);
     }
 
-    bool normal = run_constraint_update(board, board_domain,
-                                        needs_reprocessing, all_sections);
-    if (!normal) {
-        return;
+    return run_constraint_update(board, board_domain,
+                                 needs_reprocessing, NULL, rules);
+}
+
+// ENGINE_AUTO's pick for a board its clues were propagated into
+solve_engine_t choose_engine(char *board, bool counting) {
+    int n_open = 0;
+    for (int i = 0; i < 81; i++) {
+        n_open += board[i] == 0;
+    }
+    int min_open = counting ? AUTO_DLX_MIN_OPEN_COUNTING : AUTO_DLX_MIN_OPEN;
+    return n_open >= min_open ? ENGINE_DLX : ENGINE_SEARCH;
+}
+
+// propagates the clues of board, then searches for the rest
+// count_limit of 0 searches for one solution, as solve does
+// returns the number of solutions found
+int propagate_and_search(char *board, solve_options_t *options,
+                         int count_limit, solve_stats_t *stats) {
+    if (options->engine == ENGINE_BITBOARD) {
+        // propagates the clues itself, on its own representation
+        STATS_TIMER(search_start);
+        int n_solutions = sudoku_bitboard(board, count_limit, stats);
+        STATS_TIME(search_start, search_seconds);
+        return n_solutions;
+    }
+    uint16_t board_domain[81];
+    if (!propagate_clues(board, board_domain, options->rules)) {
+        return 0;
+    }
+    STATS_TIMER(search_start);
+    solve_engine_t engine = options->engine;
+    if (engine == ENGINE_AUTO) {
+        engine = choose_engine(board, count_limit > 0);
+    }
+    int n_solutions;
+    if (engine == ENGINE_DLX) {
+        n_solutions = sudoku_dlx(board, board_domain, count_limit, stats);
+    } else if (count_limit > 0) {
+        n_solutions = sudoku_count(board, board_domain, count_limit,
+                                   options, stats);
+    } else if (options->n_threads > 1) {
+        n_solutions = sudoku_search_parallel(board, board_domain,
+                                             options, stats);
+    } else {
+        n_solutions = sudoku_search(board, board_domain, options, stats);
+    }
+    STATS_TIME(search_start, search_seconds);
+    return n_solutions;
+}
+
+// fills in stats, if given, around propagate_and_search
+int run_solver(char *board, solve_options_t *options, int count_limit,
+               solve_stats_t *stats) {
+    STATS_RESET();
+    // the search fills in expansion_count, and the counters are
+    // added from this thread's
+    solve_stats_t counted = solve_stats_t();
+    int n_solutions = propagate_and_search(board, options,
+                                           count_limit, &counted);
+    if (stats) {
+        STATS_MERGE_INTO(&counted);
+        *stats = counted;
+    }
+    return n_solutions;
+}
+
+// stats, if given, is filled in with what the solve took
+bool solve(char *board, solve_options_t *options, solve_stats_t *stats) {
+    return run_solver(board, options, 0, stats) > 0;
+}
+
+// Counts the solutions of board, stopping once options->count_limit are
+// found, so a limit of 2 is enough to tell if a puzzle is unique.
+// Reuses the propagation and undo trail of the in-place search, so no
+// solution costs a fresh solve or a copy of the board. Always runs on
+// this thread. board is left as the first solution found, if any.
+// returns the number of solutions found, at most options->count_limit
+int count_solutions(char *board, solve_options_t *options,
+                    solve_stats_t *stats) {
+    return run_solver(board, options, options->count_limit, stats);
+}
+
+// count_solutions if options->count_limit is set, else solve
+int solve_or_count(char *board, solve_options_t *options,
+                   solve_stats_t *stats) {
+    if (options->count_limit > 0) {
+        return count_solutions(board, options, stats);
+    }
+    return solve(board, options, stats);
+}
+
+void print_usage(char *name) {
+    printf("usage: %s [-e engine] [-g [-v]] [-p rules] [-t threads] "
+           "[-c limit]\n"
+           "       %s -G count [-j threads] [-n clues] [-y symmetry] "
+           "[-s seed] [output]\n"
+           "       %s -b [-e engine] [-g [-v]] [-p rules] [-j threads] "
+           "[-t threads] [-c limit] [-x box] [input [output]]\n"
+           "       %s -B [-e engine] [-g [-v]] [-p rules] [-t threads] "
+           "[-c limit] [-r rounds] [-o json] [corpus ...]\n"
+           "\n"
+           "With no arguments, solves suinput.csv repeatedly for timing.\n"
+           "With -b, solves every puzzle in input (default stdin) and writes\n"
+           "one 81-digit solution line per puzzle to output (default stdout).\n"
+           "Puzzles may be 81-character lines ('0' or '.' for blanks)\n"
+           "or 9x9 comma-separated grids as in suinput.csv. Any other\n"
+           "line, such as a truncated puzzle, is an error.\n"
+           "Unsolvable puzzles are written as 81 zeros.\n"
+           "-j sets how many puzzles are solved at once (default: cores).\n"
+           "-t sets how many threads search each puzzle (default: 1).\n"
+           "-e picks what searches after propagation: search (default),\n"
+           "   dlx for dancing links on one thread, or auto to pick one\n"
+           "   for each puzzle by how many cells propagation left open.\n"
+           "   bitboard propagates and searches on one thread with a\n"
+           "   bitboard of places for each value, without -p's rules.\n"
+           "-g searches with the generic tree_search, copying the board\n"
+           "   for every guess, instead of in place with an undo trail.\n"
+           "-v with -g on one thread, skips states already expanded,\n"
+           "   found by their Zobrist hashes.\n"
+           "-p adds propagation rules, comma-separated: locked for\n"
+           "   locked candidates, subsets for naked and hidden subsets of\n"
+           "   2-4 cells, fish for X-wings and swordfish, and adaptive to\n"
+           "   skip rules that keep finding nothing. all for every one.\n"
+           "--cell-order picks the cell the search guesses at: first\n"
+           "   (default) for the first with two candidates, or the fewest\n"
+           "   candidates with ties to the most unsolved peers\n"
+           "   (mrv-degree) or to a value with the fewest places left in\n"
+           "   a row, column, or box (mrv-units).\n"
+           "--value-order picks the order its values are tried: lowest\n"
+           "   (default), lcv for the fewest unsolved peers with the\n"
+           "   value first, or hidden for the fewest places left first.\n"
+           "-c counts solutions, up to this many (2 checks uniqueness).\n"
+           "   With -b, each line is then the count, a space, and the\n"
+           "   first solution. Counting searches in place on one thread.\n"
+           "-x solves boards of box x box boxes instead: 2 for 4x4, 4 for\n"
+           "   16x16, or 5 for 25x25 (3 runs 9x9 through the same generic\n"
+           "   solver). Cells are one character each, with 'A' for 10 on\n"
+           "   up, or lines of comma-separated numbers. Only with -b, and\n"
+           "   only -c, -j, -t, and --stats apply: its search is in place\n"
+           "   with the basic rules, so -e, -g, -v, -p, --cell-order, and\n"
+           "   --value-order are rejected. With -t, counting is split\n"
+           "   over the threads too.\n"
+           "With -B, benchmarks each corpus file (default: suinput0-2.csv\n"
+           "and puzzles/*.txt), timing every puzzle one at a time.\n"
+           "-r solves each corpus this many times (default: 3).\n"
+           "-o also writes the results as JSON to this file.\n"
+           "--stats writes solver statistics as JSON to stderr at the end:\n"
+           "   for the last solve, or totals with -b and -B. Counters other\n"
+           "   than nodes expanded need a build with make STATS=1.\n"
+           "With -G, writes count new unique puzzles to output (default\n"
+           "stdout), one 81-character line each, generated on -j threads.\n"
+           "-n removes clues down to at most this many (default: 24).\n"
+           "-y keeps the clues symmetric: none, rot180 (default), rot90,\n"
+           "   mirror, or diagonal.\n"
+           "-s seeds the generator (default: 1).\n",
+           name, name, name, name);
+}
+
+// returns false if name isn't an engine
+bool parse_engine(const char *name, solve_engine_t *engine) {
+    const char *names[] = { "search", "dlx", "auto", "bitboard" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *engine = (solve_engine_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns false if name isn't a cell order
+bool parse_cell_order(const char *name, cell_order_t *order) {
+    const char *names[] = { "first", "mrv-degree", "mrv-units" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *order = (cell_order_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// returns false if name isn't a value order
+bool parse_value_order(const char *name, value_order_t *order) {
+    const char *names[] = { "lowest", "lcv", "hidden" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *order = (value_order_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a comma-separated list of propagation rules: locked, subsets,
+// fish, adaptive, or all for every one.
+// returns false if one isn't a rule
+bool parse_rules(const char *list, uint32_t *rules) {
+    const char *names[] = { "locked", "subsets", "fish", "adaptive" };
+    *rules = 0;
+    const char *name = list;
+    while (*name) {
+        size_t length = strcspn(name, ",");
+        bool known = false;
+        if (length == 3 && strncmp(name, "all", 3) == 0) {
+            *rules |= PROPAGATE_ALL;
+            known = true;
+        }
+        for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+            if (strlen(names[i]) == length &&
+                    strncmp(name, names[i], length) == 0) {
+                *rules |= 1 << i;
+                known = true;
+            }
+        }
+        if (!known) {
+            return false;
+        }
+        name += length;
+        if (*name == ',') {
+            name++;
+        }
     }
-    sudoku_search(board, board_domain, debug);
+    return true;
+}
+
+// parses a positive count for option opt, or exits with the usage
+int parse_count(char *name, char opt, const char *arg) {
+    int n = atoi(arg);
+    if (n <= 0) {
+        fprintf(stderr, "-%c needs a positive count\n", opt);
+        print_usage(name);
+        exit(1);
+    }
+    return n;
 }
 
 int main(int argc, char **argv) {
-    if (argc != 1) {
-        printf("usage: %s\n", argv[0]);
+    bool batch = false;
+    bool benchmark = false;
+    int n_threads = 0;
+    int n_rounds = 3;
+    const char *json_path = NULL;
+    bool print_stats = false;
+    solve_options_t options = { 0 };
+    options.n_threads = 1;
+    int n_generate = 0;
+    generate_options_t generate_options;
+    generate_options.target_clues = 24;
+    generate_options.symmetry = SYMMETRY_ROTATE_180;
+    generate_options.seed = 1;
+
+    // long options with no short form get values past any char
+    const int STATS_OPTION = 256;
+    const int CELL_ORDER_OPTION = 257;
+    const int VALUE_ORDER_OPTION = 258;
+    const struct option long_options[] = {
+        { "stats", no_argument, NULL, STATS_OPTION },
+        { "cell-order", required_argument, NULL, CELL_ORDER_OPTION },
+        { "value-order", required_argument, NULL, VALUE_ORDER_OPTION },
+        { NULL, 0, NULL, 0 },
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "bBc:e:gG:j:n:o:p:r:s:t:vx:y:",
+                              long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            batch = true;
+            break;
+        case 'B':
+            benchmark = true;
+            break;
+        case 'c':
+            options.count_limit = parse_count(argv[0], opt, optarg);
+            break;
+        case 'e':
+            if (!parse_engine(optarg, &options.engine)) {
+                fprintf(stderr, "unknown engine %s\n", optarg);
+                print_usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case 'g':
+            options.use_tree_search = true;
+            break;
+        case 'G':
+            n_generate = parse_count(argv[0], opt, optarg);
+            break;
+        case 'j':
+            n_threads = parse_count(argv[0], opt, optarg);
+            break;
+        case 'n':
+            generate_options.target_clues = parse_count(argv[0], opt, optarg);
+            break;
+        case 'o':
+            json_path = optarg;
+            break;
+        case 'p':
+            if (!parse_rules(optarg, &options.rules)) {
+                fprintf(stderr, "unknown rules %s\n", optarg);
+                print_usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case 'r':
+            n_rounds = parse_count(argv[0], opt, optarg);
+            break;
+        case 's':
+            generate_options.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 't':
+            options.n_threads = parse_count(argv[0], opt, optarg);
+            break;
+        case 'v':
+            options.use_visited_set = true;
+            break;
+        case 'x':
+            options.box_size = parse_count(argv[0], opt, optarg);
+            if (options.box_size > 5) {
+                fprintf(stderr, "-x box sizes go up to 5\n");
+                exit(1);
+            }
+            break;
+        case 'y':
+            if (!parse_symmetry(optarg, &generate_options.symmetry)) {
+                fprintf(stderr, "unknown symmetry %s\n", optarg);
+                print_usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case STATS_OPTION:
+            print_stats = true;
+            break;
+        case CELL_ORDER_OPTION:
+            if (!parse_cell_order(optarg, &options.branching.cell_order)) {
+                fprintf(stderr, "unknown cell order %s\n", optarg);
+                print_usage(argv[0]);
+                exit(1);
+            }
+            break;
+        case VALUE_ORDER_OPTION:
+            if (!parse_value_order(optarg,
+                                   &options.branching.value_order)) {
+                fprintf(stderr, "unknown value order %s\n", optarg);
+                print_usage(argv[0]);
+                exit(1);
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (options.box_size != 0) {
+        const char *unsupported = NULL;
+        if (!batch || benchmark || n_generate > 0) {
+            unsupported = "anything but -b";
+        } else if (options.engine != ENGINE_SEARCH) {
+            unsupported = "-e";
+        } else if (options.use_tree_search || options.use_visited_set) {
+            unsupported = "-g or -v";
+        } else if (options.rules) {
+            unsupported = "-p";
+        } else if (options.branching.cell_order != CELL_ORDER_FIRST ||
+                   options.branching.value_order != VALUE_ORDER_LOWEST) {
+            unsupported = "--cell-order or --value-order";
+        }
+        if (unsupported) {
+            fprintf(stderr, "-x doesn't work with %s\n", unsupported);
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+    int n_args = argc - optind;
+    solve_stats_t stats = solve_stats_t();
+    solve_stats_t *stats_p = print_stats ? &stats : NULL;
+
+    if (n_generate > 0) {
+        if (n_args > 1) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        const char *out_path = n_args >= 1 ? argv[optind] : "-";
+        return generate_puzzles_file(out_path, n_generate, n_threads,
+                                     &generate_options);
+    }
+    if (benchmark || batch) {
+        int status;
+        if (benchmark) {
+            status = run_benchmark(&argv[optind], n_args, n_rounds,
+                                   json_path, &options, stats_p);
+        } else {
+            if (n_args > 2) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+            const char *in_path = n_args >= 1 ? argv[optind] : "-";
+            const char *out_path = n_args >= 2 ? argv[optind + 1] : "-";
+            status = solve_batch_files(in_path, out_path,
+                                       n_threads, &options, stats_p);
+        }
+        if (print_stats) {
+            write_stats_json(stderr, &stats, "");
+            fprintf(stderr, "\n");
+        }
+        return status;
+    }
+    if (n_args != 0) {
+        print_usage(argv[0]);
         exit(1);
     }
 
@@ -412,13 +827,18 @@ int main(int argc, char **argv) {
     while (seconds() - start_time < 0.5) {
         char board_copy[81];
         memcpy(board_copy, board, sizeof(board));
-        solve(board_copy, false);
+        solve_or_count(board_copy, &options, NULL);
         n++;
     }
     double elapsed_time = seconds() - start_time;
 
-    solve(board, true);
+    options.debug = true;
+    solve_or_count(board, &options, stats_p);
     print_board(board);
 
     printf("solved board %d times in avg of %.6f seconds\n", n, elapsed_time / n);
+    if (print_stats) {
+        write_stats_json(stderr, &stats, "");
+        fprintf(stderr, "\n");
+    }
 }
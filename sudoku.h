@@ -2,19 +2,204 @@
 
 #include "general_search.h"
 #include "queues.h"
+#include "sudoku_stats.h"
+
+#include <stdio.h>
+
+// what searches a puzzle once its clues are propagated
+typedef enum solve_engine {
+    // sudoku_search, sudoku_search_parallel, or sudoku_count
+    ENGINE_SEARCH,
+    // sudoku_dlx, dancing links on what's left as an exact cover
+    ENGINE_DLX,
+    // picks one of the above for each puzzle, see choose_engine
+    ENGINE_AUTO,
+    // sudoku_bitboard, propagation and search on one bitboard per value
+    // instead of board and board_domain
+    ENGINE_BITBOARD,
+} solve_engine_t;
+
+// which unsolved cell the search guesses at next
+typedef enum cell_order {
+    // the first cell with two candidates, else the first with the fewest
+    CELL_ORDER_FIRST,
+    // the fewest candidates (MRV), ties going to the cell with the most
+    // unsolved peers
+    CELL_ORDER_MRV_DEGREE,
+    // the fewest candidates, ties going to the cell with a candidate that
+    // has the fewest places left in one of its sections
+    CELL_ORDER_MRV_UNITS,
+} cell_order_t;
+
+// the order a cell's candidates are tried in
+typedef enum value_order {
+    // lowest value first
+    VALUE_ORDER_LOWEST,
+    // least constraining value: fewest unsolved peers that have it
+    VALUE_ORDER_LEAST_CONSTRAINING,
+    // fewest places left in one of the cell's sections, so values that
+    // are nearly hidden singles (and so more likely right) go first
+    VALUE_ORDER_HIDDEN_SINGLES,
+} value_order_t;
+
+typedef struct branching {
+    cell_order_t cell_order;
+    value_order_t value_order;
+} branching_t;
+
+// propagation rules run_constraint_update can use beyond naked and hidden
+// singles and naked subsets of identical domains, as a bitmask
+// (see sudoku_rules.cpp)
+#define PROPAGATE_LOCKED_CANDIDATES (1 << 0)
+// naked and hidden subsets of 2 to 4 cells
+#define PROPAGATE_SUBSETS (1 << 1)
+// X-wings and swordfish
+#define PROPAGATE_FISH (1 << 2)
+// skips rules that keep finding nothing for a while, see run_extra_rules
+#define PROPAGATE_ADAPTIVE (1 << 3)
+#define PROPAGATE_ALL ((1 << 4) - 1)
+
+typedef struct solve_options {
+    // threads searching each puzzle, above 1 uses sudoku_search_parallel
+    // (or solve_nxn_parallel with box_size)
+    int n_threads;
+    // search with tree_search, copying the state for every child,
+    // instead of in place with an undo trail
+    bool use_tree_search;
+    // with use_tree_search, skip states already expanded,
+    // found by their Zobrist hashes
+    bool use_visited_set;
+    // when not 0, count_solutions is used instead of solve, counting up to
+    // this many solutions (2 tells unique puzzles from the rest)
+    int count_limit;
+    solve_engine_t engine;
+    // how ENGINE_SEARCH picks its guesses
+    branching_t branching;
+    // PROPAGATE_* rules to use, 0 for just the basic ones
+    uint32_t rules;
+    // boxes are box_size x box_size cells, so the board is box_size^2 on a
+    // side. 0 or 3 for the usual 9x9, others go to sudoku_nxn.cpp.
+    int box_size;
+    bool debug;
+} solve_options_t;
+
+// cells the generator keeps or removes together, so the clues
+// come out symmetric
+typedef enum symmetry {
+    SYMMETRY_NONE,
+    // 180 degree rotation about the center
+    SYMMETRY_ROTATE_180,
+    // 90 degree rotation, four cells at a time
+    SYMMETRY_ROTATE_90,
+    // left-right mirror
+    SYMMETRY_MIRROR,
+    // mirror across the main diagonal
+    SYMMETRY_DIAGONAL,
+} symmetry_t;
+
+typedef struct generate_options {
+    // clues are removed until at most this many are left, as long as the
+    // puzzle stays unique
+    int target_clues;
+    symmetry_t symmetry;
+    // the same seed and options always give the same puzzles
+    uint64_t seed;
+} generate_options_t;
+
+// Old contents of one cell, saved before propagation changes it
+typedef struct trail_entry {
+    uint8_t i;
+    char board;
+    uint16_t board_domain;
+} trail_entry_t;
+
+// Undo log for searching in place. Every change to board and board_domain
+// is recorded before it is made, so trail_undo can roll the board back
+// to any earlier trail size.
+typedef struct trail {
+    trail_entry_t *entries;
+    int size;
+    int capacity;
+} trail_t;
 
 // from sudoku_search.cpp
-void sudoku_search(char *board, uint16_t *board_domain, bool debug);
-bool is_board_solveable(char *board, uint16_t *board_domain);
+bool sudoku_search(char *board, uint16_t *board_domain,
+                   solve_options_t *options, solve_stats_t *stats);
+bool sudoku_search_parallel(char *board, uint16_t *board_domain,
+                            solve_options_t *options, solve_stats_t *stats);
+int sudoku_count(char *board, uint16_t *board_domain, int limit,
+                 solve_options_t *options, solve_stats_t *stats);
 
 // from sudoku.cpp
+bool run_ac3(char *board, uint16_t *board_domain,
+             uint64_t *needs_reprocessing, trail_t *trail);
 bool run_constraint_update(char *board, uint16_t *board_domain,
-                           uint64_t *needs_reprocessing, int *all_sections);
+                           uint64_t *needs_reprocessing, trail_t *trail,
+                           uint32_t rules);
+bool propagate_clues(char *board, uint16_t *board_domain, uint32_t rules);
+void trail_init(trail_t *trail);
+void trail_destroy(trail_t *trail);
+void trail_grow(trail_t *trail);
+void trail_undo(trail_t *trail, int size,
+                char *board, uint16_t *board_domain);
 int count_on_bits(uint16_t val);
 int which_on_bit(uint16_t val);
-int *get_all_sections();
-void check_add(char *board, int i, int number);
+bool check_add_fails(char *board, uint64_t *needs_reprocessing,
+                     int i, int number);
+void check_add(char *board, uint64_t *needs_reprocessing,
+               int i, int number);
 void print_board(char *board);
+bool solve(char *board, solve_options_t *options, solve_stats_t *stats);
+int count_solutions(char *board, solve_options_t *options,
+                    solve_stats_t *stats);
+int solve_or_count(char *board, solve_options_t *options,
+                   solve_stats_t *stats);
+double seconds();
+
+// from sudoku_rules.cpp
+bool run_extra_rules(char *board, uint16_t *board_domain,
+                     uint64_t *needs_reprocessing, trail_t *trail,
+                     uint32_t rules, bool *made_change);
+
+// from sudoku_dlx.cpp
+int sudoku_dlx(char *board, uint16_t *board_domain, int limit,
+               solve_stats_t *stats);
+
+// from sudoku_bitboard.cpp
+int sudoku_bitboard(char *board, int limit, solve_stats_t *stats);
+
+// from sudoku_batch.cpp
+bool read_puzzle(FILE *f, char *board, int *line_on);
+void write_solution(FILE *f, char *board, int n_solutions, bool counting);
+void print_batch_summary(int n_puzzles, int n_unsolved, int n_several,
+                         bool counting, double elapsed_time);
+int solve_batch(FILE *in, FILE *out, int n_threads,
+                solve_options_t *options, solve_stats_t *stats);
+int solve_batch_files(const char *in_path, const char *out_path,
+                      int n_threads, solve_options_t *options,
+                      solve_stats_t *stats);
+
+// from sudoku_nxn.cpp
+bool read_puzzle_nxn(FILE *f, int side, uint8_t *values, int *line_on);
+void write_solution_nxn(FILE *f, int side, uint8_t *values, int n_solutions,
+                        bool counting);
+int solve_batch_nxn(FILE *in, FILE *out, int n_threads,
+                    solve_options_t *options, solve_stats_t *stats);
+
+// from sudoku_generate.cpp
+bool parse_symmetry(const char *name, symmetry_t *symmetry);
+int generate_puzzles(FILE *out, int n_puzzles, int n_threads,
+                     generate_options_t *options);
+int generate_puzzles_file(const char *out_path, int n_puzzles, int n_threads,
+                          generate_options_t *options);
+
+// from sudoku_bench.cpp
+int run_benchmark(char **paths, int n_paths, int n_rounds,
+                  const char *json_path, solve_options_t *options,
+                  solve_stats_t *stats);
+
+// a domain with every value, bit-1 through bit-9
+#define BITS_1_9_SET (((1 << 10) - 1) & ~1)
 
 // From http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetTable
 static const unsigned char BitsSetTable256[256] = {
@@ -41,6 +226,21 @@ inline int which_on_bit64(uint64_t val) {
     return __builtin_ctzl(val);
 }
 
+// saves cell i before it changes, when there is a trail to save it on
+inline void trail_save(trail_t *trail, char *board, uint16_t *board_domain,
+                       int i) {
+    if (!trail) {
+        return;
+    }
+    if (trail->size == trail->capacity) {
+        trail_grow(trail);
+    }
+    trail_entry_t *entry = &trail->entries[trail->size++];
+    entry->i = i;
+    entry->board = board[i];
+    entry->board_domain = board_domain[i];
+}
+
 inline void reprocessing_insert(uint64_t *needs_reprocessing, int i) {
     if (i >= 64) {
         // note the constant must be marked long
@@ -71,3 +271,39 @@ inline bool reprocessing_contains(uint64_t *needs_reprocessing, int i) {
         return needs_reprocessing[0] & (1L << i);
     }
 }
+
+// The section half of needs_reprocessing. After the 81 cell bits, a third
+// word holds the sections where a domain shrank or a cell was solved since
+// a rule last looked at them, so run_only_viable and run_n_domain_reduction
+// only wake the sections that changed. Bits 0-26 are run_only_viable's,
+// and the same sections shifted up by 32 are run_n_domain_reduction's.
+// A board any of these have run on to the end, with no sections left dirty,
+// has nothing left for them to find, so searches start from all clean.
+#define REPROCESSING_WORDS 3
+#define SECTIONS_HIDDEN_SHIFT 0
+#define SECTIONS_SUBSET_SHIFT 32
+#define ALL_SECTIONS ((1 << 27) - 1)
+
+// marks sections (a bitmask, bit-0 for section 0) dirty for every rule
+inline void sections_mark_dirty(uint64_t *needs_reprocessing,
+                                uint32_t sections) {
+    needs_reprocessing[2] |= (uint64_t)sections << SECTIONS_HIDDEN_SHIFT |
+                             (uint64_t)sections << SECTIONS_SUBSET_SHIFT;
+}
+
+// true when every section is already dirty for every rule, as after
+// propagate_clues, so there is nothing to gain from marking more
+inline bool sections_all_dirty(uint64_t *needs_reprocessing) {
+    const uint64_t all = (uint64_t)ALL_SECTIONS << SECTIONS_HIDDEN_SHIFT |
+                         (uint64_t)ALL_SECTIONS << SECTIONS_SUBSET_SHIFT;
+    return (needs_reprocessing[2] & all) == all;
+}
+
+// takes the sections dirty for one rule (the shift of its bits),
+// leaving them clean
+inline uint32_t sections_take_dirty(uint64_t *needs_reprocessing,
+                                    int shift) {
+    uint32_t sections = (needs_reprocessing[2] >> shift) & ALL_SECTIONS;
+    needs_reprocessing[2] &= ~((uint64_t)sections << shift);
+    return sections;
+}
@@ -0,0 +1,481 @@
+#include "sudoku.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::thread;
+using std::vector;
+
+// large buffers so millions of puzzles don't cost a syscall each
+#define BATCH_IO_BUFFER_SIZE (1 << 20)
+// Puzzles are read, solved, and written this many at a time, so memory
+// stays bounded on huge inputs. Up to BATCH_CHUNKS_IN_FLIGHT chunks are
+// out at once: workers move on to the next chunk as soon as theirs has no
+// work left, so a slow puzzle only holds up the writing of its own chunk,
+// while the other chunks are solved, and then written and read again.
+#define BATCH_CHUNK_SIZE (1 << 12)
+#define BATCH_CHUNKS_IN_FLIGHT 4
+
+// A contiguous range of puzzle indices owned by one worker.
+// The owner takes puzzles from the front; a thief splits off the back half.
+// So a worker stuck on one slow puzzle hands the rest of its range to the
+// idle workers instead of holding up a static partition.
+typedef struct work_range {
+    mutex lock;
+    int begin;
+    int end;
+} work_range_t;
+
+typedef struct batch_chunk {
+    vector<char> boards;
+    // solutions found for each board, from solve_or_count
+    vector<int> n_solutions;
+    int n_puzzles;
+    // one for each worker
+    vector<work_range_t> ranges;
+    int n_workers;
+    // puzzles not solved yet, so the chunk can be written once it is 0
+    atomic<int> n_left;
+} batch_chunk_t;
+
+// Shared by the workers and the thread reading and writing puzzles.
+// Chunk k of the input (from 0) is in chunks[k % BATCH_CHUNKS_IN_FLIGHT].
+typedef struct batch {
+    batch_chunk_t chunks[BATCH_CHUNKS_IN_FLIGHT];
+    int n_workers;
+    solve_options_t *options;
+    // if not NULL, every worker adds up its solves' stats in here
+    solve_stats_t *stats;
+    mutex stats_lock;
+
+    // guards the chunk counts, and is signaled when they change or a
+    // chunk is solved
+    mutex lock;
+    condition_variable changed;
+    // chunks read and ready to solve, and chunks written (and so free)
+    int64_t n_read;
+    int64_t n_written;
+    bool input_done;
+} batch_t;
+
+// The cells of one line of a puzzle file
+typedef struct puzzle_line {
+    // its number in the file, from 1
+    int number;
+    // the first 81 cells, 0 for blanks
+    char cells[81];
+    // cells on the line, up to anything that is neither a cell nor a
+    // separator
+    int n_cells;
+    // cells before the first separator that follows a cell
+    int first_field;
+    // the character that stopped the cells early, or 0
+    int unexpected;
+} puzzle_line_t;
+
+// Reads the next line of f with anything on it into line, skipping blank
+// lines and comments ('#' runs to the end of the line). Digits and '.'
+// are cells, and commas and whitespace separate them.
+// returns false at EOF
+bool read_puzzle_line(FILE *f, puzzle_line_t *line, int *line_on) {
+    while (1) {
+        // getc_unlocked avoids taking the stream lock for every character
+        int c = getc_unlocked(f);
+        if (c == EOF) {
+            return false;
+        }
+        line->number = ++(*line_on);
+        line->n_cells = 0;
+        line->first_field = -1;
+        line->unexpected = 0;
+        bool in_comment = false;
+        for (; c != '\n' && c != EOF; c = getc_unlocked(f)) {
+            if (in_comment || line->unexpected) {
+                continue;
+            }
+            if (c == '#') {
+                in_comment = true;
+                continue;
+            }
+            if (c == ',' || c == '\r' || c == ' ' || c == '\t') {
+                if (line->n_cells > 0 && line->first_field == -1) {
+                    line->first_field = line->n_cells;
+                }
+                continue;
+            }
+            if (c == '.') {
+                c = '0';
+            }
+            if (c < '0' || c > '9') {
+                line->unexpected = c;
+                continue;
+            }
+            if (line->n_cells < 81) {
+                line->cells[line->n_cells] = c - '0';
+            }
+            line->n_cells++;
+        }
+        if (line->first_field == -1) {
+            line->first_field = line->n_cells;
+        }
+        if (line->n_cells > 0 || line->unexpected) {
+            return true;
+        }
+    }
+}
+
+// Reads the next puzzle from f into board.
+// Accepts both one 81-cell line per puzzle ('0' or '.' for blanks) and
+// 9x9 grids of one 9-cell row per line, comma-separated as in suinput.csv.
+// Blank lines and comments ('#' to the end of the line) are skipped.
+// A one-line puzzle may be followed by other columns (like an included
+// solution) after a comma or whitespace. Any other line, such as a
+// truncated puzzle, is an error, rather than being joined with the next.
+// returns true if a puzzle was read, false on a clean EOF before any values
+bool read_puzzle(FILE *f, char *board, int *line_on) {
+    puzzle_line_t line;
+    if (!read_puzzle_line(f, &line, line_on)) {
+        return false;
+    }
+    if (line.first_field == 81 || (line.n_cells == 81 && !line.unexpected)) {
+        memcpy(board, line.cells, 81);
+        return true;
+    }
+
+    if (line.n_cells == 9 && !line.unexpected) {
+        for (int row = 0; ; row++) {
+            memcpy(&board[row * 9], line.cells, 9);
+            if (row == 8) {
+                return true;
+            }
+            if (!read_puzzle_line(f, &line, line_on)) {
+                fprintf(stderr, "Unexpected EOF on line %d "
+                                "after reading %d rows\n",
+                                *line_on, row + 1);
+                exit(1);
+            }
+            if (line.unexpected) {
+                break;
+            }
+            if (line.n_cells != 9) {
+                fprintf(stderr, "Line %d has %d cells, not a row's 9\n",
+                                line.number, line.n_cells);
+                exit(1);
+            }
+        }
+    }
+
+    if (line.unexpected) {
+        fprintf(stderr, "Unexpected character '%c' on line %d\n",
+                        line.unexpected, line.number);
+        exit(1);
+    }
+    fprintf(stderr, "Line %d has %d cells, not 81 (or 9 for a row)\n",
+                    line.number, line.n_cells);
+    exit(1);
+}
+
+// writes board as a single line of 81 digits
+// in counting mode, the line starts with the number of solutions found
+// and a space
+void write_solution(FILE *f, char *board, int n_solutions, bool counting) {
+    if (counting) {
+        fprintf(f, "%d ", n_solutions);
+    }
+    char line[82];
+    for (int i = 0; i < 81; i++) {
+        line[i] = '0' + board[i];
+    }
+    line[81] = '\n';
+    fwrite(line, 1, sizeof(line), f);
+}
+
+// returns the next puzzle index from the front of range, or -1 if empty
+int take_own_work(work_range_t *range) {
+    lock_guard<mutex> guard(range->lock);
+    if (range->begin >= range->end) {
+        return -1;
+    }
+    return range->begin++;
+}
+
+// moves the back half of some other worker's range into worker_i's range
+// returns false when every other range was found empty
+bool steal_work(batch_chunk_t *chunk, int worker_i) {
+    for (int k = 1; k < chunk->n_workers; k++) {
+        int victim_i = (worker_i + k) % chunk->n_workers;
+        work_range_t *victim = &chunk->ranges[victim_i];
+        int begin;
+        int end;
+        {
+            lock_guard<mutex> guard(victim->lock);
+            int remaining = victim->end - victim->begin;
+            if (remaining <= 0) {
+                continue;
+            }
+            // the victim keeps the front half, at least until it gets to it
+            begin = victim->begin + remaining / 2;
+            end = victim->end;
+            victim->end = begin;
+        }
+        work_range_t *own = &chunk->ranges[worker_i];
+        lock_guard<mutex> guard(own->lock);
+        own->begin = begin;
+        own->end = end;
+        return true;
+    }
+    return false;
+}
+
+// solves the puzzles of chunk worker_i can get, adding to worker_stats
+void solve_chunk(batch_t *batch, batch_chunk_t *chunk, int worker_i,
+                 solve_stats_t *worker_stats) {
+    while (1) {
+        int i = take_own_work(&chunk->ranges[worker_i]);
+        if (i == -1) {
+            if (!steal_work(chunk, worker_i)) {
+                return;
+            }
+            continue;
+        }
+        solve_stats_t stats;
+        chunk->n_solutions[i] = solve_or_count(&chunk->boards[i * 81],
+                                               batch->options,
+                                               batch->stats ? &stats : NULL);
+        if (batch->stats) {
+            solve_stats_add(worker_stats, &stats);
+        }
+        if (--chunk->n_left == 0) {
+            lock_guard<mutex> guard(batch->lock);
+            batch->changed.notify_all();
+        }
+    }
+}
+
+// Works through the chunks in input order until the input runs out
+void batch_worker(batch_t *batch, int worker_i) {
+    solve_stats_t worker_stats = solve_stats_t();
+    int64_t k = 0;
+    while (1) {
+        {
+            unique_lock<mutex> lock(batch->lock);
+            // chunks before n_written are done, and their places may
+            // already hold later chunks
+            if (k < batch->n_written) {
+                k = batch->n_written;
+            }
+            while (k >= batch->n_read && !batch->input_done) {
+                batch->changed.wait(lock);
+            }
+            if (k >= batch->n_read) {
+                break;
+            }
+        }
+        // Chunk k can't be written while it still has work to give out.
+        // If it has been since, and a later chunk has taken its place,
+        // the puzzles taken here are that chunk's, which is as good.
+        solve_chunk(batch, &batch->chunks[k % BATCH_CHUNKS_IN_FLIGHT],
+                    worker_i, &worker_stats);
+        k++;
+    }
+    if (batch->stats) {
+        lock_guard<mutex> guard(batch->stats_lock);
+        solve_stats_add(batch->stats, &worker_stats);
+    }
+}
+
+// Reads up to BATCH_CHUNK_SIZE puzzles into chunk, splitting them evenly
+// between the workers. returns how many were read
+int read_chunk(FILE *in, batch_chunk_t *chunk, int *line_on) {
+    int n_puzzles = 0;
+    while (n_puzzles < BATCH_CHUNK_SIZE &&
+           read_puzzle(in, &chunk->boards[n_puzzles * 81], line_on)) {
+        n_puzzles++;
+    }
+    chunk->n_puzzles = n_puzzles;
+    chunk->n_left = n_puzzles;
+    int n_workers = chunk->n_workers;
+    for (int worker_i = 0; worker_i < n_workers; worker_i++) {
+        work_range_t *range = &chunk->ranges[worker_i];
+        lock_guard<mutex> guard(range->lock);
+        range->begin = (int64_t)n_puzzles * worker_i / n_workers;
+        range->end = (int64_t)n_puzzles * (worker_i + 1) / n_workers;
+    }
+    return n_puzzles;
+}
+
+// Makes the chunk just read available to the workers, or if it is empty,
+// ends the input
+void publish_chunk(batch_t *batch, int n_puzzles) {
+    lock_guard<mutex> guard(batch->lock);
+    if (n_puzzles == 0) {
+        batch->input_done = true;
+    } else {
+        batch->n_read++;
+    }
+    batch->changed.notify_all();
+}
+
+// the line solve_batch and solve_batch_nxn end with on stderr
+void print_batch_summary(int n_puzzles, int n_unsolved, int n_several,
+                         bool counting, double elapsed_time) {
+    if (counting) {
+        fprintf(stderr, "%d of %d puzzles unique, %d with no solution, "
+                        "%d with several, in %.3f seconds "
+                        "(avg of %.6f seconds)\n",
+                n_puzzles - n_unsolved - n_several, n_puzzles, n_unsolved,
+                n_several, elapsed_time,
+                n_puzzles ? elapsed_time / n_puzzles : 0.0);
+        return;
+    }
+    fprintf(stderr, "solved %d of %d puzzles in %.3f seconds "
+                    "(avg of %.6f seconds)\n",
+            n_puzzles - n_unsolved, n_puzzles, elapsed_time,
+            n_puzzles ? elapsed_time / n_puzzles : 0.0);
+}
+
+// Solves every puzzle in `in`, writing solutions to `out` in input order.
+// Unsolvable puzzles are written as a line of zeros.
+// With options->count_limit set, each line is instead the number of
+// solutions found (up to the limit), a space, and the first solution.
+// n_threads of 0 uses one thread per core.
+// Each puzzle is solved with options, which are shared by every worker.
+// If stats isn't NULL, the stats of every solve are added to it.
+// returns the number of puzzles that had no solution,
+// or when counting, that didn't have exactly one
+int solve_batch(FILE *in, FILE *out, int n_threads,
+                solve_options_t *options, solve_stats_t *stats) {
+    if (n_threads <= 0) {
+        n_threads = thread::hardware_concurrency();
+        if (n_threads <= 0) {
+            n_threads = 1;
+        }
+    }
+
+    int line_on = 0;
+    int n_puzzles = 0;
+    int n_unsolved = 0;
+    int n_several = 0;
+    bool counting = options->count_limit > 0;
+
+    batch_t batch;
+    batch.n_workers = n_threads;
+    batch.options = options;
+    batch.stats = stats;
+    batch.n_read = 0;
+    batch.n_written = 0;
+    batch.input_done = false;
+    for (int c = 0; c < BATCH_CHUNKS_IN_FLIGHT; c++) {
+        batch_chunk_t *chunk = &batch.chunks[c];
+        chunk->boards.resize(BATCH_CHUNK_SIZE * 81);
+        chunk->n_solutions.resize(BATCH_CHUNK_SIZE);
+        chunk->ranges = vector<work_range_t>(n_threads);
+        chunk->n_workers = n_threads;
+        chunk->n_puzzles = 0;
+        chunk->n_left = 0;
+    }
+
+    double start_time = seconds();
+    vector<thread> threads;
+    for (int worker_i = 0; worker_i < n_threads; worker_i++) {
+        threads.push_back(thread(batch_worker, &batch, worker_i));
+    }
+
+    // This thread keeps every place filled with a chunk being solved,
+    // writing out the oldest once it is done and reading the next into it
+    for (int c = 0; c < BATCH_CHUNKS_IN_FLIGHT && !batch.input_done; c++) {
+        publish_chunk(&batch, read_chunk(in, &batch.chunks[c], &line_on));
+    }
+    while (batch.n_written < batch.n_read) {
+        batch_chunk_t *chunk =
+                &batch.chunks[batch.n_written % BATCH_CHUNKS_IN_FLIGHT];
+        {
+            unique_lock<mutex> lock(batch.lock);
+            while (chunk->n_left > 0) {
+                batch.changed.wait(lock);
+            }
+        }
+
+        for (int i = 0; i < chunk->n_puzzles; i++) {
+            char *board = &chunk->boards[i * 81];
+            if (chunk->n_solutions[i] == 0) {
+                memset(board, 0, 81);
+                n_unsolved++;
+            } else if (chunk->n_solutions[i] > 1) {
+                n_several++;
+            }
+            write_solution(out, board, chunk->n_solutions[i], counting);
+        }
+        n_puzzles += chunk->n_puzzles;
+
+        {
+            lock_guard<mutex> guard(batch.lock);
+            batch.n_written++;
+        }
+        if (!batch.input_done) {
+            publish_chunk(&batch, read_chunk(in, chunk, &line_on));
+        }
+    }
+    publish_chunk(&batch, 0);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    double elapsed_time = seconds() - start_time;
+
+    print_batch_summary(n_puzzles, n_unsolved, n_several, counting,
+                        elapsed_time);
+    return counting ? n_unsolved + n_several : n_unsolved;
+}
+
+// "-" means stdin for in_path and stdout for out_path
+// returns an exit status: 0 if all puzzles were solved (or were unique)
+int solve_batch_files(const char *in_path, const char *out_path,
+                      int n_threads, solve_options_t *options,
+                      solve_stats_t *stats) {
+    FILE *in = stdin;
+    if (strcmp(in_path, "-") != 0) {
+        in = fopen(in_path, "r");
+        if (!in) {
+            fprintf(stderr, "Could not open %s for reading\n", in_path);
+            return 1;
+        }
+    }
+    FILE *out = stdout;
+    if (strcmp(out_path, "-") != 0) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s for writing\n", out_path);
+            return 1;
+        }
+    }
+    setvbuf(in, NULL, _IOFBF, BATCH_IO_BUFFER_SIZE);
+    setvbuf(out, NULL, _IOFBF, BATCH_IO_BUFFER_SIZE);
+
+    int n_unsolved;
+    if (options->box_size == 0) {
+        n_unsolved = solve_batch(in, out, n_threads, options, stats);
+    } else {
+        n_unsolved = solve_batch_nxn(in, out, n_threads, options, stats);
+    }
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (out != stdout) {
+        fclose(out);
+    } else {
+        fflush(out);
+    }
+    return n_unsolved ? 2 : 0;
+}
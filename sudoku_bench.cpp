@@ -0,0 +1,259 @@
+#include "sudoku.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+using std::vector;
+
+// Benchmark mode: solves each corpus one puzzle at a time on this thread,
+// timing every solve, so the latencies show the tail and not just an average.
+// Puzzles are all read in before the clock starts, so file parsing is never
+// part of a measurement.
+
+typedef struct bench_result {
+    const char *path;
+    int n_puzzles;
+    int n_solved;
+    // solves timed, n_puzzles for each round
+    int n_samples;
+    double total_seconds;
+    double p50_seconds;
+    double p90_seconds;
+    double p99_seconds;
+    double max_seconds;
+    double mean_expansions;
+    int64_t max_expansions;
+    // summed over every solve
+    solve_stats_t stats;
+    // of the whole process so far, as the OS doesn't track it per corpus
+    long peak_rss_kb;
+} bench_result_t;
+
+// corpora run when none are named on the command line
+static const char *DEFAULT_CORPORA[] = {
+    "suinput0.csv", "suinput1.csv", "suinput2.csv",
+    "puzzles/easy.txt", "puzzles/17clue.txt", "puzzles/hardest.txt",
+};
+
+long peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return -1;
+    }
+    // kilobytes on Linux
+    return usage.ru_maxrss;
+}
+
+// nearest-rank percentile of sorted, p from 0 to 1
+double percentile(vector<double> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = (size_t)ceil(p * sorted.size());
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+// returns false if path could not be read
+bool read_corpus(const char *path, vector<char> *boards) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return false;
+    }
+    int line_on = 0;
+    char board[81];
+    while (read_puzzle(f, board, &line_on)) {
+        boards->insert(boards->end(), board, board + 81);
+    }
+    fclose(f);
+    return true;
+}
+
+void bench_corpus(vector<char> &boards, int n_rounds,
+                  solve_options_t *options, bench_result_t *result) {
+    int n_puzzles = boards.size() / 81;
+    vector<double> latencies;
+    latencies.reserve((size_t)n_puzzles * n_rounds);
+    double total_expansions = 0;
+
+    result->n_puzzles = n_puzzles;
+    result->n_solved = 0;
+    result->max_expansions = 0;
+    result->total_seconds = 0;
+    result->stats = solve_stats_t();
+    for (int round = 0; round < n_rounds; round++) {
+        for (int i = 0; i < n_puzzles; i++) {
+            char board[81];
+            memcpy(board, &boards[i * 81], sizeof(board));
+            solve_stats_t stats;
+
+            double start_time = seconds();
+            bool solved = solve_or_count(board, options, &stats) > 0;
+            double elapsed_time = seconds() - start_time;
+
+            latencies.push_back(elapsed_time);
+            result->total_seconds += elapsed_time;
+            total_expansions += stats.expansion_count;
+            result->max_expansions = std::max(result->max_expansions,
+                                              stats.expansion_count);
+            solve_stats_add(&result->stats, &stats);
+            if (round == 0 && solved) {
+                result->n_solved++;
+            }
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    result->n_samples = latencies.size();
+    result->p50_seconds = percentile(latencies, 0.50);
+    result->p90_seconds = percentile(latencies, 0.90);
+    result->p99_seconds = percentile(latencies, 0.99);
+    result->max_seconds = latencies.empty() ? 0 : latencies.back();
+    result->mean_expansions = latencies.empty() ? 0 :
+                                total_expansions / latencies.size();
+    result->peak_rss_kb = peak_rss_kb();
+}
+
+double puzzles_per_second(bench_result_t *result) {
+    if (result->total_seconds <= 0) {
+        return 0;
+    }
+    return result->n_samples / result->total_seconds;
+}
+
+void print_bench_result(bench_result_t *result) {
+    printf("%-22s %7d %7d %10.0f %9.1f %9.1f %9.1f %9.1f %10.1f %8ld\n",
+           result->path, result->n_puzzles, result->n_solved,
+           puzzles_per_second(result),
+           result->p50_seconds * 1e6, result->p90_seconds * 1e6,
+           result->p99_seconds * 1e6, result->max_seconds * 1e6,
+           result->mean_expansions, result->peak_rss_kb);
+}
+
+// writes s as a JSON string
+void write_json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+// with_stats adds each corpus's solve_stats_t
+void write_bench_json(FILE *f, bench_result_t *results, int n_results,
+                      int n_rounds, solve_options_t *options,
+                      bool with_stats) {
+    fprintf(f, "{\n");
+    const char *engines[] = { "search", "dlx", "auto", "bitboard" };
+    fprintf(f, "  \"engine\": \"%s\",\n", engines[options->engine]);
+    fprintf(f, "  \"search\": \"%s\",\n",
+            options->use_tree_search ? "tree_search" : "in_place");
+    const char *cell_orders[] = { "first", "mrv-degree", "mrv-units" };
+    const char *value_orders[] = { "lowest", "lcv", "hidden" };
+    fprintf(f, "  \"cell_order\": \"%s\",\n",
+            cell_orders[options->branching.cell_order]);
+    fprintf(f, "  \"value_order\": \"%s\",\n",
+            value_orders[options->branching.value_order]);
+    fprintf(f, "  \"rules\": %u,\n", options->rules);
+    fprintf(f, "  \"search_threads\": %d,\n", options->n_threads);
+    fprintf(f, "  \"count_limit\": %d,\n", options->count_limit);
+    fprintf(f, "  \"rounds\": %d,\n", n_rounds);
+    fprintf(f, "  \"corpora\": [\n");
+    for (int i = 0; i < n_results; i++) {
+        bench_result_t *result = &results[i];
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"path\": ");
+        write_json_string(f, result->path);
+        fprintf(f, ",\n");
+        fprintf(f, "      \"puzzles\": %d,\n", result->n_puzzles);
+        fprintf(f, "      \"solved\": %d,\n", result->n_solved);
+        fprintf(f, "      \"seconds\": %.6f,\n", result->total_seconds);
+        fprintf(f, "      \"puzzles_per_second\": %.1f,\n",
+                puzzles_per_second(result));
+        fprintf(f, "      \"latency_us\": {\"p50\": %.3f, \"p90\": %.3f, "
+                   "\"p99\": %.3f, \"max\": %.3f},\n",
+                result->p50_seconds * 1e6, result->p90_seconds * 1e6,
+                result->p99_seconds * 1e6, result->max_seconds * 1e6);
+        fprintf(f, "      \"nodes_per_puzzle\": {\"mean\": %.2f, "
+                   "\"max\": %lld},\n",
+                result->mean_expansions, (long long)result->max_expansions);
+        if (with_stats) {
+            fprintf(f, "      \"stats\": ");
+            write_stats_json(f, &result->stats, "      ");
+            fprintf(f, ",\n");
+        }
+        fprintf(f, "      \"peak_rss_kb\": %ld\n", result->peak_rss_kb);
+        fprintf(f, "    }%s\n", i + 1 < n_results ? "," : "");
+    }
+    fprintf(f, "  ],\n");
+    fprintf(f, "  \"peak_rss_kb\": %ld\n", peak_rss_kb());
+    fprintf(f, "}\n");
+}
+
+// Benchmarks each of paths (or DEFAULT_CORPORA if there are none),
+// solving every puzzle n_rounds times. Prints a table, and writes the same
+// results as JSON to json_path if it isn't NULL ("-" for stdout).
+// If stats isn't NULL, the stats of every solve are added to it, and each
+// corpus's are included in the JSON.
+// returns an exit status: 0 if every corpus was read and fully solved
+int run_benchmark(char **paths, int n_paths, int n_rounds,
+                  const char *json_path, solve_options_t *options,
+                  solve_stats_t *stats) {
+    if (n_paths == 0) {
+        paths = (char**)DEFAULT_CORPORA;
+        n_paths = sizeof(DEFAULT_CORPORA) / sizeof(DEFAULT_CORPORA[0]);
+    }
+
+    printf("%-22s %7s %7s %10s %9s %9s %9s %9s %10s %8s\n",
+           "corpus", "puzzles", "solved", "puzzles/s", "p50 us", "p90 us",
+           "p99 us", "max us", "nodes/puz", "rss KB");
+
+    int status = 0;
+    vector<bench_result_t> results;
+    for (int i = 0; i < n_paths; i++) {
+        vector<char> boards;
+        if (!read_corpus(paths[i], &boards)) {
+            fprintf(stderr, "Could not open %s for reading\n", paths[i]);
+            status = 1;
+            continue;
+        }
+        bench_result_t result;
+        result.path = paths[i];
+        bench_corpus(boards, n_rounds, options, &result);
+        print_bench_result(&result);
+        if (stats) {
+            solve_stats_add(stats, &result.stats);
+        }
+        if (result.n_solved != result.n_puzzles && status == 0) {
+            status = 2;
+        }
+        results.push_back(result);
+    }
+
+    if (json_path) {
+        FILE *f = stdout;
+        if (strcmp(json_path, "-") != 0) {
+            f = fopen(json_path, "w");
+            if (!f) {
+                fprintf(stderr, "Could not open %s for writing\n", json_path);
+                return 1;
+            }
+        }
+        write_bench_json(f, results.data(), results.size(),
+                         n_rounds, options, stats != NULL);
+        if (f != stdout) {
+            fclose(f);
+        }
+    }
+    return status;
+}
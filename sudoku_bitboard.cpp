@@ -0,0 +1,232 @@
+#include "sudoku.h"
+#include "sudoku_tables.h"
+
+#include <stdint.h>
+
+// Sudoku on a digit-major board: for each value, one bitboard of the cells
+// it can still go in, instead of a domain for each cell. Taking a placed
+// value out of its peers, or every other value out of its cell, is then an
+// AND-NOT with a mask for each of the ten bitboards, and where a value can
+// go in a section is one AND. The clues are propagated here too, with naked
+// and hidden singles, so nothing of board and board_domain is used.
+
+// 81 cells, bit-0 for cell 0
+typedef unsigned __int128 cells_t;
+
+#define ALL_CELLS (((cells_t)1 << 81) - 1)
+
+typedef struct bitboard {
+    // candidates[v] has the cells value v + 1 can still go in. A solved
+    // cell stays in the bitboard of its value only.
+    cells_t candidates[9];
+    cells_t solved;
+} bitboard_t;
+
+// the whole search's, shared by its recursion
+typedef struct bitboard_search {
+    char *board;
+    int solution_limit;
+    int n_solutions;
+    int32_t expansion_count;
+} bitboard_search_t;
+
+static inline cells_t to_cells(const uint64_t *bits) {
+    return (cells_t)bits[1] << 64 | bits[0];
+}
+
+static inline int lowest_cell(cells_t cells) {
+    uint64_t low = (uint64_t)cells;
+    return low ? __builtin_ctzll(low)
+               : __builtin_ctzll((uint64_t)(cells >> 64)) + 64;
+}
+
+// places value v + 1 in cell i, which must still be one of its candidates
+static inline void bitboard_place(bitboard_t *b, int i, int v) {
+    cells_t cell = (cells_t)1 << i;
+    for (int w = 0; w < 9; w++) {
+        b->candidates[w] &= ~cell;
+    }
+    b->candidates[v] = (b->candidates[v] &
+                        ~to_cells(TABLES.peer_bits[i])) | cell;
+    b->solved |= cell;
+}
+
+// the values cell i can still take, bit-1 for 1 like board_domain
+static inline uint16_t bitboard_domain(bitboard_t *b, int i) {
+    uint16_t domain = 0;
+    for (int v = 0; v < 9; v++) {
+        domain |= (uint16_t)((b->candidates[v] >> i) & 1) << (v + 1);
+    }
+    return domain;
+}
+
+// Places naked and hidden singles until there are none left.
+// returns false if a cell has no candidates left, or a section has no
+// place left for a value, so the board can't be solved
+bool bitboard_propagate(bitboard_t *b) {
+    while (1) {
+        // cells with at least one and with at least two candidates
+        cells_t any = 0;
+        cells_t multiple = 0;
+        for (int v = 0; v < 9; v++) {
+            multiple |= any & b->candidates[v];
+            any |= b->candidates[v];
+        }
+        if (any != ALL_CELLS) {
+            return false;
+        }
+        cells_t singles = ~multiple & ~b->solved & ALL_CELLS;
+        if (singles) {
+            for (int v = 0; v < 9; v++) {
+                // an earlier single may have taken some of these
+                cells_t placing = singles & b->candidates[v];
+                while (placing) {
+                    int i = lowest_cell(placing);
+                    placing &= placing - 1;
+                    if (!((b->candidates[v] >> i) & 1)) {
+                        return false;
+                    }
+                    bitboard_place(b, i, v);
+                }
+            }
+            continue;
+        }
+
+        bool placed = false;
+        for (int v = 0; v < 9; v++) {
+            if (!(b->candidates[v] & ~b->solved)) {
+                // every place of this value is filled
+                continue;
+            }
+            for (int s = 0; s < 27; s++) {
+                cells_t places = b->candidates[v] &
+                                 to_cells(TABLES.section_cell_bits[s]);
+                if (!places) {
+                    return false;
+                }
+                if (!(places & (places - 1)) && !(places & b->solved)) {
+                    bitboard_place(b, lowest_cell(places), v);
+                    STATS_ADD(hidden_singles, 1);
+                    placed = true;
+                }
+            }
+        }
+        if (!placed) {
+            return true;
+        }
+    }
+}
+
+// the unsolved cell to guess at: the first with two candidates,
+// else the first with the fewest. -1 if every cell is solved.
+int bitboard_decision_cell(bitboard_t *b) {
+    cells_t open = ~b->solved & ALL_CELLS;
+    if (!open) {
+        return -1;
+    }
+    // cells with at least one, two, and three candidates, bit-sliced
+    cells_t one = 0;
+    cells_t two = 0;
+    cells_t three = 0;
+    for (int v = 0; v < 9; v++) {
+        cells_t c = b->candidates[v];
+        three |= two & c;
+        two |= one & c;
+        one |= c;
+    }
+    cells_t pairs = open & two & ~three;
+    if (pairs) {
+        return lowest_cell(pairs);
+    }
+    int best_i = -1;
+    int best_count = 10;
+    while (open) {
+        int i = lowest_cell(open);
+        open &= open - 1;
+        int count = count_on_bits(bitboard_domain(b, i));
+        if (count < best_count) {
+            best_i = i;
+            best_count = count;
+        }
+    }
+    return best_i;
+}
+
+// Each guess works on a copy of the bitboard, 160 bytes, so there is
+// nothing to undo. returns true once solution_limit solutions are found
+bool bitboard_search(bitboard_t *b, bitboard_search_t *search, int depth) {
+    int i = bitboard_decision_cell(b);
+    if (i == -1) {
+        if (search->n_solutions == 0) {
+            for (int v = 0; v < 9; v++) {
+                cells_t cells = b->candidates[v];
+                while (cells) {
+                    search->board[lowest_cell(cells)] = v + 1;
+                    cells &= cells - 1;
+                }
+            }
+        }
+        search->n_solutions++;
+        return search->n_solutions >= search->solution_limit;
+    }
+    search->expansion_count++;
+    STATS_MAX(max_depth, depth + 1);
+
+    uint16_t options = bitboard_domain(b, i);
+    while (options) {
+        int v = which_on_bit(options) - 1;
+        options &= options - 1;
+        STATS_ADD(guesses, 1);
+
+        bitboard_t child = *b;
+        bitboard_place(&child, i, v);
+        if (!bitboard_propagate(&child)) {
+            STATS_ADD(backtracks, 1);
+            continue;
+        }
+        if (bitboard_search(&child, search, depth + 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Solves board from its clues alone, stopping once limit solutions are
+// found (1 to just solve). board is left as the first solution found,
+// if any. If stats isn't NULL, its expansion_count is set to the cells
+// branched on.
+// returns the number of solutions found, at most limit
+int sudoku_bitboard(char *board, int limit, solve_stats_t *stats) {
+    bitboard_t b;
+    for (int v = 0; v < 9; v++) {
+        b.candidates[v] = ALL_CELLS;
+    }
+    b.solved = 0;
+
+    bitboard_search_t search;
+    search.board = board;
+    search.solution_limit = limit > 1 ? limit : 1;
+    search.n_solutions = 0;
+    search.expansion_count = 0;
+
+    bool normal = true;
+    for (int i = 0; i < 81 && normal; i++) {
+        if (board[i] == 0) {
+            continue;
+        }
+        // a clue an earlier one already ruled out conflicts with it
+        int v = board[i] - 1;
+        normal = (b.candidates[v] >> i) & 1;
+        if (normal) {
+            bitboard_place(&b, i, v);
+        }
+    }
+    if (normal && bitboard_propagate(&b)) {
+        bitboard_search(&b, &search, 0);
+    }
+
+    if (stats) {
+        stats->expansion_count = search.expansion_count;
+    }
+    return search.n_solutions;
+}
@@ -0,0 +1,209 @@
+#include "sudoku.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Knuth's Algorithm X with dancing links, on sudoku as an exact cover:
+// a row for each candidate value of each cell, and a column for each
+// constraint, that every cell has a value and every row, column, and box
+// has every value once. Only the candidates propagation left are made rows,
+// and columns already satisfied by solved cells are left out, so the
+// matrix is usually much smaller than the full 729 x 324.
+
+// cell constraints, then row-value, column-value, and box-value
+#define DLX_COLUMNS (4 * 81)
+// the root, then a header for each column
+#define DLX_HEADERS (1 + DLX_COLUMNS)
+#define DLX_MAX_NODES (DLX_HEADERS + 4 * 729)
+
+typedef struct dlx {
+    // circular links, nodes 1 to DLX_COLUMNS are the column headers
+    int16_t left[DLX_MAX_NODES];
+    int16_t right[DLX_MAX_NODES];
+    int16_t up[DLX_MAX_NODES];
+    int16_t down[DLX_MAX_NODES];
+    int16_t column[DLX_MAX_NODES];
+    // the candidate a node's row stands for, as cell * 9 + value - 1
+    int16_t candidate[DLX_MAX_NODES];
+    // nodes in each column
+    int16_t size[DLX_HEADERS];
+    int n_nodes;
+
+    // the rows chosen on the current path
+    int16_t chosen[81];
+    char *board;
+    int solution_limit;
+    int n_solutions;
+    int32_t expansion_count;
+} dlx_t;
+
+// the column header for each of candidate i, value's four constraints
+static inline void dlx_candidate_columns(int i, int value, int *columns) {
+    int row = i / 9;
+    int col = i % 9;
+    int box = (row / 3) * 3 + col / 3;
+    columns[0] = 1 + i;
+    columns[1] = 1 + 81 + row * 9 + value - 1;
+    columns[2] = 1 + 2 * 81 + col * 9 + value - 1;
+    columns[3] = 1 + 3 * 81 + box * 9 + value - 1;
+}
+
+// links in the columns the solved cells of board don't satisfy,
+// and a row for each candidate of the rest
+void dlx_build(dlx_t *x, char *board, uint16_t *board_domain) {
+    bool satisfied[DLX_HEADERS] = { false };
+    for (int i = 0; i < 81; i++) {
+        if (board[i] != 0) {
+            int columns[4];
+            dlx_candidate_columns(i, board[i], columns);
+            for (int k = 0; k < 4; k++) {
+                satisfied[columns[k]] = true;
+            }
+        }
+    }
+
+    int last = 0;
+    for (int c = 1; c < DLX_HEADERS; c++) {
+        x->up[c] = c;
+        x->down[c] = c;
+        x->size[c] = 0;
+        if (satisfied[c]) {
+            continue;
+        }
+        x->right[last] = c;
+        x->left[c] = last;
+        last = c;
+    }
+    x->right[last] = 0;
+    x->left[0] = last;
+
+    x->n_nodes = DLX_HEADERS;
+    for (int i = 0; i < 81; i++) {
+        if (board[i] != 0) {
+            continue;
+        }
+        uint16_t options = board_domain[i];
+        while (options) {
+            int value = __builtin_ctz(options);
+            options &= options - 1;
+
+            int columns[4];
+            dlx_candidate_columns(i, value, columns);
+            int first = x->n_nodes;
+            for (int k = 0; k < 4; k++) {
+                int node = x->n_nodes++;
+                int c = columns[k];
+                x->column[node] = c;
+                x->candidate[node] = i * 9 + value - 1;
+                x->up[node] = x->up[c];
+                x->down[node] = c;
+                x->down[x->up[c]] = node;
+                x->up[c] = node;
+                x->size[c]++;
+                x->left[node] = k == 0 ? first + 3 : node - 1;
+                x->right[node] = k == 3 ? first : node + 1;
+            }
+        }
+    }
+}
+
+static inline void dlx_cover(dlx_t *x, int c) {
+    x->right[x->left[c]] = x->right[c];
+    x->left[x->right[c]] = x->left[c];
+    for (int i = x->down[c]; i != c; i = x->down[i]) {
+        for (int j = x->right[i]; j != i; j = x->right[j]) {
+            x->down[x->up[j]] = x->down[j];
+            x->up[x->down[j]] = x->up[j];
+            x->size[x->column[j]]--;
+        }
+    }
+}
+
+static inline void dlx_uncover(dlx_t *x, int c) {
+    for (int i = x->up[c]; i != c; i = x->up[i]) {
+        for (int j = x->left[i]; j != i; j = x->left[j]) {
+            x->size[x->column[j]]++;
+            x->down[x->up[j]] = j;
+            x->up[x->down[j]] = j;
+        }
+    }
+    x->right[x->left[c]] = c;
+    x->left[x->right[c]] = c;
+}
+
+// the uncovered column with the fewest rows left
+static inline int dlx_choose_column(dlx_t *x) {
+    int best_c = x->right[0];
+    int best_size = x->size[best_c];
+    for (int c = x->right[best_c]; c != 0 && best_size > 1;
+         c = x->right[c]) {
+        if (x->size[c] < best_size) {
+            best_c = c;
+            best_size = x->size[c];
+        }
+    }
+    return best_c;
+}
+
+// returns true once solution_limit solutions are found
+bool dlx_search(dlx_t *x, int depth) {
+    if (x->right[0] == 0) {
+        if (x->n_solutions == 0) {
+            for (int k = 0; k < depth; k++) {
+                int candidate = x->candidate[x->chosen[k]];
+                x->board[candidate / 9] = candidate % 9 + 1;
+            }
+        }
+        x->n_solutions++;
+        return x->n_solutions >= x->solution_limit;
+    }
+
+    int c = dlx_choose_column(x);
+    if (x->size[c] == 0) {
+        STATS_ADD(backtracks, 1);
+        return false;
+    }
+    x->expansion_count++;
+    STATS_MAX(max_depth, depth + 1);
+
+    dlx_cover(x, c);
+    for (int r = x->down[c]; r != c; r = x->down[r]) {
+        STATS_ADD(guesses, 1);
+        x->chosen[depth] = r;
+        for (int j = x->right[r]; j != r; j = x->right[j]) {
+            dlx_cover(x, x->column[j]);
+        }
+        if (dlx_search(x, depth + 1)) {
+            // the matrix is thrown away, so there's no need to restore it
+            return true;
+        }
+        for (int j = x->left[r]; j != r; j = x->left[j]) {
+            dlx_uncover(x, x->column[j]);
+        }
+    }
+    dlx_uncover(x, c);
+    return false;
+}
+
+// Solves board, as already propagated into board_domain, with dancing
+// links, stopping once limit solutions are found (1 to just solve).
+// board is left as the first solution found, if any.
+// If stats isn't NULL, its expansion_count is set to the columns branched on.
+// returns the number of solutions found, at most limit
+int sudoku_dlx(char *board, uint16_t *board_domain, int limit,
+               solve_stats_t *stats) {
+    // ~40KB, kept off the stack of the worker threads
+    static thread_local dlx_t x;
+    dlx_build(&x, board, board_domain);
+    x.board = board;
+    x.solution_limit = limit > 1 ? limit : 1;
+    x.n_solutions = 0;
+    x.expansion_count = 0;
+
+    dlx_search(&x, 0);
+
+    if (stats) {
+        stats->expansion_count = x.expansion_count;
+    }
+    return x.n_solutions;
+}
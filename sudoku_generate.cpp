@@ -0,0 +1,338 @@
+#include "sudoku.h"
+#include "sudoku_tables.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::thread;
+using std::vector;
+
+// puzzles are generated and written this many at a time
+#define GENERATE_CHUNK_SIZE (1 << 12)
+// full grids tried per puzzle when the target clue count isn't reached
+#define GENERATE_MAX_TRIES 16
+
+// A small splitmix64 generator. Unlike <random>'s distributions it gives
+// the same puzzles for a seed on every platform.
+typedef struct rng {
+    uint64_t state;
+} rng_t;
+
+uint64_t rng_next(rng_t *rng) {
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// uniform in [0, n), the bias is negligible for the small n used here
+int rng_below(rng_t *rng, int n) {
+    return (int)(rng_next(rng) % n);
+}
+
+template <typename T>
+void shuffle(rng_t *rng, T *items, int n) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = rng_below(rng, i + 1);
+        T tmp = items[i];
+        items[i] = items[j];
+        items[j] = tmp;
+    }
+}
+
+// returns false if name isn't a symmetry
+bool parse_symmetry(const char *name, symmetry_t *symmetry) {
+    const char *names[] = { "none", "rot180", "rot90", "mirror", "diagonal" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *symmetry = (symmetry_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Splits the cells into groups that symmetry maps onto each other,
+// which are always removed together. Fills groups[g] with the cells of
+// group g and group_sizes[g] with how many there are.
+// returns the number of groups
+int symmetry_groups(symmetry_t symmetry, uint8_t groups[81][4],
+                    int *group_sizes) {
+    bool grouped[81] = { false };
+    int n_groups = 0;
+    for (int i = 0; i < 81; i++) {
+        if (grouped[i]) {
+            continue;
+        }
+        int row = i / 9;
+        int col = i % 9;
+        int orbit[4] = { i, i, i, i };
+        switch (symmetry) {
+        case SYMMETRY_NONE:
+            break;
+        case SYMMETRY_ROTATE_180:
+            orbit[1] = (8 - row) * 9 + (8 - col);
+            break;
+        case SYMMETRY_ROTATE_90:
+            orbit[1] = col * 9 + (8 - row);
+            orbit[2] = (8 - row) * 9 + (8 - col);
+            orbit[3] = (8 - col) * 9 + row;
+            break;
+        case SYMMETRY_MIRROR:
+            orbit[1] = row * 9 + (8 - col);
+            break;
+        case SYMMETRY_DIAGONAL:
+            orbit[1] = col * 9 + row;
+            break;
+        }
+
+        int size = 0;
+        for (int k = 0; k < 4; k++) {
+            if (!grouped[orbit[k]]) {
+                grouped[orbit[k]] = true;
+                groups[n_groups][size++] = orbit[k];
+            }
+        }
+        group_sizes[n_groups++] = size;
+    }
+    return n_groups;
+}
+
+// Fills solution with a random complete grid. The three boxes on the
+// diagonal share no row or column, so any digits in them are consistent,
+// and the search fills in the rest.
+void random_full_grid(rng_t *rng, char *solution) {
+    memset(solution, 0, 81);
+    for (int box = 0; box < 3; box++) {
+        char digits[9] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+        shuffle(rng, digits, 9);
+        for (int k = 0; k < 9; k++) {
+            int row = box * 3 + k / 3;
+            int col = box * 3 + k % 3;
+            solution[row * 9 + col] = digits[k];
+        }
+    }
+    solve_options_t options = { 0 };
+    options.n_threads = 1;
+    if (!solve(solution, &options, NULL)) {
+        fprintf(stderr, "Fatal Error: no grid completes the diagonal boxes\n");
+        exit(1);
+    }
+}
+
+// True if puzzle has a solution other than solution, given that puzzle
+// was unique before the clues in cells were removed. Any other solution
+// must then differ from solution in one of those cells, so each of them
+// is searched with its solution value ruled out. The clues are propagated
+// just once for all of them, and each search stops at its first solution
+// instead of counting.
+bool has_other_solution(char *puzzle, char *solution,
+                        uint8_t *cells, int n_cells) {
+    char board[81];
+    uint16_t board_domain[81];
+    memcpy(board, puzzle, sizeof(board));
+    if (!propagate_clues(board, board_domain, 0)) {
+        return false;
+    }
+
+    solve_options_t options = { 0 };
+    options.n_threads = 1;
+    for (int k = 0; k < n_cells; k++) {
+        int i = cells[k];
+        if (board[i] != 0) {
+            // propagation alone puts the solution value back
+            continue;
+        }
+        char other_board[81];
+        uint16_t other_domain[81];
+        memcpy(other_board, board, sizeof(other_board));
+        memcpy(other_domain, board_domain, sizeof(other_domain));
+
+        other_domain[i] &= ~(1 << solution[i]);
+        if (other_domain[i] == 0) {
+            continue;
+        }
+        // the rest of the board is as propagate_clues left it
+        uint64_t needs_reprocessing[REPROCESSING_WORDS] = { 0 };
+        sections_mark_dirty(needs_reprocessing, TABLES.cell_section_bits[i]);
+        if (count_on_bits(other_domain[i]) == 1) {
+            other_board[i] = which_on_bit(other_domain[i]);
+            reprocessing_insert(needs_reprocessing, i);
+        }
+        if (run_constraint_update(other_board, other_domain,
+                                  needs_reprocessing, NULL, 0) &&
+            sudoku_search(other_board, other_domain, &options, NULL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Makes a puzzle from a random full grid by removing groups of clues in
+// random order, keeping each removal only if the puzzle stays unique,
+// until at most options->target_clues are left. Tries new grids while the
+// target isn't reached, keeping the puzzle with the fewest clues.
+// index seeds the puzzle, so the output doesn't depend on thread timing.
+// returns the number of clues in puzzle
+int generate_puzzle(generate_options_t *options, uint64_t index,
+                    char *puzzle) {
+    rng_t rng = { options->seed };
+    rng.state = rng_next(&rng) ^ index;
+
+    uint8_t groups[81][4];
+    int group_sizes[81];
+    int n_groups = symmetry_groups(options->symmetry, groups, group_sizes);
+    int order[81];
+    for (int g = 0; g < n_groups; g++) {
+        order[g] = g;
+    }
+
+    int best_clues = 82;
+    for (int attempt = 0; attempt < GENERATE_MAX_TRIES; attempt++) {
+        char solution[81];
+        char candidate[81];
+        random_full_grid(&rng, solution);
+        memcpy(candidate, solution, sizeof(candidate));
+        int n_clues = 81;
+
+        shuffle(&rng, order, n_groups);
+        for (int o = 0; o < n_groups && n_clues > options->target_clues;
+             o++) {
+            uint8_t *cells = groups[order[o]];
+            int size = group_sizes[order[o]];
+            for (int k = 0; k < size; k++) {
+                candidate[cells[k]] = 0;
+            }
+            if (has_other_solution(candidate, solution, cells, size)) {
+                for (int k = 0; k < size; k++) {
+                    candidate[cells[k]] = solution[cells[k]];
+                }
+            } else {
+                n_clues -= size;
+            }
+        }
+
+        if (n_clues < best_clues) {
+            best_clues = n_clues;
+            memcpy(puzzle, candidate, 81);
+        }
+        if (best_clues <= options->target_clues) {
+            break;
+        }
+    }
+    return best_clues;
+}
+
+typedef struct generate_chunk {
+    generate_options_t *options;
+    uint64_t first_index;
+    int n_puzzles;
+    atomic<int> next;
+    char *puzzles;
+    int *n_clues;
+} generate_chunk_t;
+
+// every puzzle takes a good while, so one shared counter is all the
+// load balancing this needs
+void generate_worker(generate_chunk_t *chunk) {
+    while (1) {
+        int i = chunk->next++;
+        if (i >= chunk->n_puzzles) {
+            return;
+        }
+        chunk->n_clues[i] = generate_puzzle(chunk->options,
+                                            chunk->first_index + i,
+                                            &chunk->puzzles[i * 81]);
+    }
+}
+
+// one line per puzzle, '.' for blanks
+void write_puzzle(FILE *f, char *puzzle) {
+    char line[82];
+    for (int i = 0; i < 81; i++) {
+        line[i] = puzzle[i] ? '0' + puzzle[i] : '.';
+    }
+    line[81] = '\n';
+    fwrite(line, 1, sizeof(line), f);
+}
+
+// Writes n_puzzles new unique puzzles to out, generated on n_threads
+// threads (0 for one per core).
+// returns the number that couldn't be brought down to the target clues
+int generate_puzzles(FILE *out, int n_puzzles, int n_threads,
+                     generate_options_t *options) {
+    if (n_threads <= 0) {
+        n_threads = thread::hardware_concurrency();
+        if (n_threads <= 0) {
+            n_threads = 1;
+        }
+    }
+
+    vector<char> puzzles(GENERATE_CHUNK_SIZE * 81);
+    vector<int> n_clues(GENERATE_CHUNK_SIZE);
+    int n_over_target = 0;
+    double total_clues = 0;
+
+    double start_time = seconds();
+    for (int first = 0; first < n_puzzles; first += GENERATE_CHUNK_SIZE) {
+        generate_chunk_t chunk;
+        chunk.options = options;
+        chunk.first_index = first;
+        chunk.n_puzzles = n_puzzles - first < GENERATE_CHUNK_SIZE ?
+                            n_puzzles - first : GENERATE_CHUNK_SIZE;
+        chunk.next = 0;
+        chunk.puzzles = puzzles.data();
+        chunk.n_clues = n_clues.data();
+
+        vector<thread> threads;
+        for (int i = 1; i < n_threads; i++) {
+            threads.push_back(thread(generate_worker, &chunk));
+        }
+        generate_worker(&chunk);
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+
+        for (int i = 0; i < chunk.n_puzzles; i++) {
+            write_puzzle(out, &puzzles[i * 81]);
+            total_clues += n_clues[i];
+            if (n_clues[i] > options->target_clues) {
+                n_over_target++;
+            }
+        }
+    }
+    double elapsed_time = seconds() - start_time;
+
+    fprintf(stderr, "generated %d puzzles (avg of %.1f clues, %d above "
+                    "target) in %.3f seconds (avg of %.6f seconds)\n",
+            n_puzzles, n_puzzles ? total_clues / n_puzzles : 0.0,
+            n_over_target, elapsed_time,
+            n_puzzles ? elapsed_time / n_puzzles : 0.0);
+    return n_over_target;
+}
+
+// "-" means stdout for out_path
+// returns an exit status: 0 if every puzzle reached the target clues
+int generate_puzzles_file(const char *out_path, int n_puzzles, int n_threads,
+                          generate_options_t *options) {
+    FILE *out = stdout;
+    if (strcmp(out_path, "-") != 0) {
+        out = fopen(out_path, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s for writing\n", out_path);
+            return 1;
+        }
+    }
+
+    int n_over_target = generate_puzzles(out, n_puzzles, n_threads, options);
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    return n_over_target ? 2 : 0;
+}
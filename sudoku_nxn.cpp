@@ -0,0 +1,406 @@
+#include "sudoku.h"
+#include "sudoku_nxn.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::mutex;
+using std::lock_guard;
+using std::string;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+
+// as BATCH_CHUNK_SIZE, smaller since a 25x25 puzzle can take a good while
+#define NXN_CHUNK_SIZE (1 << 10)
+
+// as PARALLEL_SPLIT_FACTOR, for solve_nxn_parallel
+#define NXN_SPLIT_FACTOR 4
+
+// the value of a one-character cell, or -1 if c isn't one
+int nxn_char_value(int c) {
+    if (c == '.') {
+        return 0;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// reads the next line of f into line, without the newline
+// returns false at EOF with nothing read
+bool read_line(FILE *f, string *line) {
+    line->clear();
+    int c = getc_unlocked(f);
+    if (c == EOF) {
+        return false;
+    }
+    while (c != '\n' && c != EOF) {
+        line->push_back(c);
+        c = getc_unlocked(f);
+    }
+    return true;
+}
+
+// Reads the next puzzle of side x side values from f into values.
+// Cells are single characters, '0' or '.' for blanks, '1'-'9', and then
+// 'A' (or 'a') for 10 up to 'P' for 25. Lines with a comma are instead
+// comma-separated numbers, as in suinput.csv, so 16 and 25 can be written
+// out. A puzzle may be one line or spread over several. Whitespace and
+// blank lines are ignored, '#' starts a comment that runs to the end of the
+// line, and the rest of the line is skipped once every value is read.
+// returns true if a puzzle was read, false on a clean EOF before any values
+bool read_puzzle_nxn(FILE *f, int side, uint8_t *values, int *line_on) {
+    int n_cells = side * side;
+    int val_on = 0;
+    string line;
+    while (val_on < n_cells) {
+        if (!read_line(f, &line)) {
+            if (val_on == 0) {
+                return false;
+            }
+            fprintf(stderr, "Unexpected EOF on line %d "
+                            "after reading %d values\n", *line_on, val_on);
+            exit(1);
+        }
+        (*line_on)++;
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line.resize(comment);
+        }
+
+        bool separated = line.find(',') != string::npos;
+        const char *c = line.c_str();
+        while (*c && val_on < n_cells) {
+            if (*c == ',' || *c == ' ' || *c == '\t' || *c == '\r') {
+                c++;
+                continue;
+            }
+            int value;
+            if (separated && *c >= '0' && *c <= '9') {
+                char *end;
+                value = strtol(c, &end, 10);
+                c = end;
+            } else {
+                value = nxn_char_value(*c);
+                if (value == -1) {
+                    fprintf(stderr, "Unexpected character '%c' on line %d\n",
+                                    *c, *line_on);
+                    exit(1);
+                }
+                c++;
+            }
+            if (value > side) {
+                fprintf(stderr, "Value %d on line %d is above %d\n",
+                                value, *line_on, side);
+                exit(1);
+            }
+            values[val_on++] = value;
+        }
+    }
+    return true;
+}
+
+// as write_solution, with one character per value as read_puzzle_nxn reads
+void write_solution_nxn(FILE *f, int side, uint8_t *values, int n_solutions,
+                        bool counting) {
+    if (counting) {
+        fprintf(f, "%d ", n_solutions);
+    }
+    int n_cells = side * side;
+    for (int i = 0; i < n_cells; i++) {
+        int value = values[i];
+        putc_unlocked(value < 10 ? '0' + value : 'A' + value - 10, f);
+    }
+    putc_unlocked('\n', f);
+}
+
+// Shared by the threads of one solve_nxn_parallel call, as
+// parallel_search_t is for 9x9. subtrees holds the boards that nobody
+// has split or searched yet.
+template <int BOX>
+struct nxn_parallel_search {
+    typedef typename nxn_solver<BOX>::subtree_t subtree_t;
+    mutex lock;
+    condition_variable work_changed;
+    vector<subtree_t> subtrees;
+    int n_threads;
+    // threads currently splitting or searching a subtree
+    int n_busy;
+    // at least 1, as the solvers take it
+    int count_limit;
+    // between all the threads, and the first of them
+    int n_solutions;
+    uint8_t first_solution[nxn_size<BOX>::CELLS];
+    // set once n_solutions reaches count_limit, to stop every search
+    atomic<bool> done;
+    atomic<int32_t> expansion_count;
+    // counters of the threads started for this search, once they finish
+    solve_stats_t thread_totals;
+};
+
+template <int BOX>
+void nxn_parallel_worker(nxn_parallel_search<BOX> *search,
+                         nxn_solver<BOX> *solver) {
+    vector<typename nxn_solver<BOX>::subtree_t> children;
+    unique_lock<mutex> lock(search->lock);
+    while (1) {
+        while (search->subtrees.empty() && search->n_busy > 0 &&
+                !search->done) {
+            search->work_changed.wait(lock);
+        }
+        if (search->done || search->subtrees.empty()) {
+            // counted up to the limit, or every subtree was exhausted
+            return;
+        }
+        solver->load(&search->subtrees.back(), search->count_limit,
+                     &search->done);
+        search->subtrees.pop_back();
+        search->n_busy++;
+        bool split = search->subtrees.size() <
+                        (size_t)(search->n_threads * NXN_SPLIT_FACTOR);
+        lock.unlock();
+
+        children.clear();
+        int n_solutions = split ? solver->split(&children)
+                                : solver->search();
+        search->expansion_count += solver->expansions();
+
+        lock.lock();
+        if (!search->done) {
+            search->subtrees.insert(search->subtrees.end(),
+                                    children.begin(), children.end());
+            if (n_solutions > 0 && search->n_solutions == 0) {
+                memcpy(search->first_solution, solver->solution(),
+                       sizeof(search->first_solution));
+            }
+            search->n_solutions += n_solutions;
+            if (search->n_solutions >= search->count_limit) {
+                search->done = true;
+            }
+        }
+        search->n_busy--;
+        search->work_changed.notify_all();
+    }
+}
+
+// the threads solve_nxn_parallel starts, each with a solver of its own,
+// which hand their counters back to the calling thread when done
+template <int BOX>
+void nxn_parallel_thread(nxn_parallel_search<BOX> *search) {
+    STATS_RESET();
+    nxn_solver<BOX> *solver = new nxn_solver<BOX>();
+    nxn_parallel_worker<BOX>(search, solver);
+    delete solver;
+#ifdef SUDOKU_STATS
+    lock_guard<mutex> guard(search->lock);
+    STATS_MERGE_INTO(&search->thread_totals);
+#endif
+}
+
+// Like solver->solve, but spreads one puzzle's search over n_threads as
+// sudoku_search_parallel does for 9x9: subtrees near the root are split
+// off into a shared stack whenever it runs low, and idle threads take
+// them. Counting is spread the same way, and every thread stops once
+// count_limit solutions are found between them.
+// returns the number of solutions found, up to count_limit
+template <int BOX>
+int solve_nxn_parallel(nxn_solver<BOX> *solver, uint8_t *values,
+                       int count_limit, int n_threads,
+                       int32_t *expansion_count) {
+    *expansion_count = 0;
+    if (!solver->start(values, count_limit)) {
+        return 0;
+    }
+
+    nxn_parallel_search<BOX> search;
+    search.subtrees.resize(1);
+    solver->store(&search.subtrees[0]);
+    search.n_threads = n_threads;
+    search.n_busy = 0;
+    search.count_limit = count_limit > 1 ? count_limit : 1;
+    search.n_solutions = 0;
+    search.done = false;
+    search.expansion_count = 0;
+    search.thread_totals = solve_stats_t();
+
+    vector<thread> threads;
+    for (int i = 1; i < n_threads; i++) {
+        threads.push_back(thread(nxn_parallel_thread<BOX>, &search));
+    }
+    nxn_parallel_worker<BOX>(&search, solver);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    STATS_MERGE_FROM(&search.thread_totals);
+
+    *expansion_count = search.expansion_count;
+    if (search.n_solutions > 0) {
+        memcpy(values, search.first_solution, sizeof(search.first_solution));
+    }
+    return search.n_solutions < search.count_limit ? search.n_solutions
+                                                   : search.count_limit;
+}
+
+typedef struct nxn_chunk {
+    uint8_t *boards;
+    int *n_solutions;
+    int n_puzzles;
+    atomic<int> next;
+    int count_limit;
+    // threads searching each puzzle, above 1 uses solve_nxn_parallel
+    int n_search_threads;
+    // if not NULL, every worker adds up its solves' stats in here
+    solve_stats_t *stats;
+    mutex stats_lock;
+} nxn_chunk_t;
+
+// Puzzles this size vary too much for fixed ranges, and are slow enough
+// that one shared counter is all the load balancing they need.
+// One solver per worker, so its trail is allocated once.
+template <int BOX>
+void nxn_worker(nxn_chunk_t *chunk) {
+    typedef nxn_size<BOX> size;
+    nxn_solver<BOX> *solver = new nxn_solver<BOX>();
+    solve_stats_t worker_stats = solve_stats_t();
+    while (1) {
+        int i = chunk->next++;
+        if (i >= chunk->n_puzzles) {
+            break;
+        }
+        STATS_RESET();
+        uint8_t *board = &chunk->boards[i * size::CELLS];
+        int32_t expansion_count;
+        if (chunk->n_search_threads > 1) {
+            chunk->n_solutions[i] = solve_nxn_parallel<BOX>(
+                                        solver, board, chunk->count_limit,
+                                        chunk->n_search_threads,
+                                        &expansion_count);
+        } else {
+            chunk->n_solutions[i] = solver->solve(board, chunk->count_limit);
+            expansion_count = solver->expansions();
+        }
+        if (chunk->stats) {
+            solve_stats_t stats = solve_stats_t();
+            STATS_MERGE_INTO(&stats);
+            stats.expansion_count = expansion_count;
+            solve_stats_add(&worker_stats, &stats);
+        }
+    }
+    delete solver;
+    if (chunk->stats) {
+        lock_guard<mutex> guard(chunk->stats_lock);
+        solve_stats_add(chunk->stats, &worker_stats);
+    }
+}
+
+// as solve_batch, for boards with BOX x BOX boxes
+template <int BOX>
+int solve_batch_box(FILE *in, FILE *out, int n_threads,
+                    solve_options_t *options, solve_stats_t *stats) {
+    typedef nxn_size<BOX> size;
+    int line_on = 0;
+    int n_puzzles = 0;
+    int n_unsolved = 0;
+    int n_several = 0;
+    bool counting = options->count_limit > 0;
+
+    vector<uint8_t> boards(NXN_CHUNK_SIZE * size::CELLS);
+    vector<int> n_solutions(NXN_CHUNK_SIZE);
+
+    double start_time = seconds();
+    while (1) {
+        int chunk_size = 0;
+        while (chunk_size < NXN_CHUNK_SIZE &&
+               read_puzzle_nxn(in, size::SIDE,
+                               &boards[chunk_size * size::CELLS], &line_on)) {
+            chunk_size++;
+        }
+        if (chunk_size == 0) {
+            break;
+        }
+
+        nxn_chunk_t chunk;
+        chunk.boards = boards.data();
+        chunk.n_solutions = n_solutions.data();
+        chunk.n_puzzles = chunk_size;
+        chunk.next = 0;
+        chunk.count_limit = options->count_limit;
+        chunk.n_search_threads = options->n_threads;
+        chunk.stats = stats;
+
+        vector<thread> threads;
+        for (int i = 1; i < n_threads; i++) {
+            threads.push_back(thread(nxn_worker<BOX>, &chunk));
+        }
+        nxn_worker<BOX>(&chunk);
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+
+        for (int i = 0; i < chunk_size; i++) {
+            uint8_t *board = &boards[i * size::CELLS];
+            if (n_solutions[i] == 0) {
+                memset(board, 0, size::CELLS);
+                n_unsolved++;
+            } else if (n_solutions[i] > 1) {
+                n_several++;
+            }
+            write_solution_nxn(out, size::SIDE, board, n_solutions[i],
+                               counting);
+        }
+        n_puzzles += chunk_size;
+    }
+    double elapsed_time = seconds() - start_time;
+
+    print_batch_summary(n_puzzles, n_unsolved, n_several, counting,
+                        elapsed_time);
+    return counting ? n_unsolved + n_several : n_unsolved;
+}
+
+// Solves every puzzle in `in` of the size options->box_size gives, as
+// solve_batch does for 9x9. Each puzzle is searched in place with the
+// basic rules, on options->n_threads threads, so of the other options only
+// count_limit applies (main rejects the rest with -x).
+// returns the number of puzzles that had no solution,
+// or when counting, that didn't have exactly one
+int solve_batch_nxn(FILE *in, FILE *out, int n_threads,
+                    solve_options_t *options, solve_stats_t *stats) {
+    if (n_threads <= 0) {
+        n_threads = thread::hardware_concurrency();
+        if (n_threads <= 0) {
+            n_threads = 1;
+        }
+    }
+
+    switch (options->box_size) {
+    case 2:
+        return solve_batch_box<2>(in, out, n_threads, options, stats);
+    case 3:
+        return solve_batch_box<3>(in, out, n_threads, options, stats);
+    case 4:
+        return solve_batch_box<4>(in, out, n_threads, options, stats);
+    case 5:
+        return solve_batch_box<5>(in, out, n_threads, options, stats);
+    default:
+        fprintf(stderr, "Fatal Error: no solver for %dx%d boxes\n",
+                options->box_size, options->box_size);
+        exit(1);
+    }
+}
@@ -0,0 +1,536 @@
+#pragma once
+
+// Solver for boards of any box size: BOX x BOX boxes, so SIDE = BOX * BOX
+// values and SIDE * SIDE cells. Each box size is its own instantiation,
+// with the narrowest domain word that holds bits 1 through SIDE and a
+// reprocessing bitset only as long as the board.
+// The 9x9 board keeps the hand-tuned solver in sudoku.cpp by default;
+// this serves 4x4, 16x16, and 25x25 with the same propagation rules
+// (naked singles, hidden singles, identical-domain subsets) and the same
+// in-place search with an undo trail. -x 3 runs 9x9 boards through the
+// BOX = 3 instantiation, to check it against the hand-tuned solver.
+// With -t, solve_nxn_parallel in sudoku_nxn.cpp hands subtrees between
+// solvers through subtree_t, split, and search.
+
+#include "sudoku.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+// one bit per cell, in as many 64-bit words as it takes
+template <int N_BITS>
+struct cell_bitset {
+    static constexpr int N_WORDS = (N_BITS + 63) / 64;
+    uint64_t words[N_WORDS];
+
+    void clear() {
+        for (int w = 0; w < N_WORDS; w++) {
+            words[w] = 0;
+        }
+    }
+    bool empty() const {
+        for (int w = 0; w < N_WORDS; w++) {
+            if (words[w]) {
+                return false;
+            }
+        }
+        return true;
+    }
+    void insert(int i) {
+        words[i / 64] |= (uint64_t)1 << (i % 64);
+    }
+    bool contains(int i) const {
+        return words[i / 64] & ((uint64_t)1 << (i % 64));
+    }
+    // removes and returns the lowest set bit, or -1 if empty
+    int pop() {
+        for (int w = 0; w < N_WORDS; w++) {
+            if (words[w]) {
+                int bit = __builtin_ctzll(words[w]);
+                words[w] &= words[w] - 1;
+                return w * 64 + bit;
+            }
+        }
+        return -1;
+    }
+};
+
+template <int BOX>
+struct nxn_size {
+    static constexpr int SIDE = BOX * BOX;
+    static constexpr int CELLS = SIDE * SIDE;
+    // rows, then columns, then boxes
+    static constexpr int N_SECTIONS = 3 * SIDE;
+    static constexpr int N_PEERS = 3 * SIDE - 2 * BOX - 1;
+    static_assert(SIDE < 32, "domains hold at most 31 values");
+
+    // bit-1 for "1" and so forth, bit-0 unused
+    typedef typename std::conditional<(SIDE < 8), uint8_t,
+            typename std::conditional<(SIDE < 16), uint16_t,
+                                      uint32_t>::type>::type domain_t;
+    static constexpr uint32_t ALL_VALUES = ((uint32_t)1 << (SIDE + 1)) - 2;
+};
+
+// like sudoku_tables_t, for any box size
+template <int BOX>
+struct nxn_tables {
+    typedef nxn_size<BOX> size;
+    uint16_t sections[size::N_SECTIONS][size::SIDE];
+    uint16_t peers[size::CELLS][size::N_PEERS];
+};
+
+template <int BOX>
+constexpr nxn_tables<BOX> make_nxn_tables() {
+    typedef nxn_size<BOX> size;
+    const int SIDE = size::SIDE;
+    nxn_tables<BOX> t = {};
+
+    for (int row = 0; row < SIDE; row++) {
+        for (int col = 0; col < SIDE; col++) {
+            int i = row * SIDE + col;
+            int box = (row / BOX) * BOX + col / BOX;
+            int box_i = (row % BOX) * BOX + col % BOX;
+            t.sections[row][col] = i;
+            t.sections[SIDE + col][row] = i;
+            t.sections[2 * SIDE + box][box_i] = i;
+        }
+    }
+
+    // the rest of the row and column, then the rest of the box
+    for (int i = 0; i < size::CELLS; i++) {
+        int row = i / SIDE;
+        int col = i % SIDE;
+        int n_peers = 0;
+        for (int k = 0; k < SIDE; k++) {
+            if (k != col) {
+                t.peers[i][n_peers++] = row * SIDE + k;
+            }
+            if (k != row) {
+                t.peers[i][n_peers++] = k * SIDE + col;
+            }
+        }
+        int box_row = row / BOX * BOX;
+        int box_col = col / BOX * BOX;
+        for (int r = box_row; r < box_row + BOX; r++) {
+            for (int c = box_col; c < box_col + BOX; c++) {
+                if (r != row && c != col) {
+                    t.peers[i][n_peers++] = r * SIDE + c;
+                }
+            }
+        }
+    }
+
+    return t;
+}
+
+template <int BOX>
+class nxn_solver {
+ public:
+    typedef nxn_size<BOX> size;
+    typedef typename size::domain_t domain_t;
+    typedef cell_bitset<size::CELLS> bitset_t;
+    static constexpr nxn_tables<BOX> TABLES = make_nxn_tables<BOX>();
+
+    // A board partway through the search, for another solver to load
+    typedef struct subtree {
+        uint8_t board[size::CELLS];
+        domain_t domain[size::CELLS];
+        int depth;
+    } subtree_t;
+
+    // Solves values (0 for blanks) in place, or with count_limit above 1,
+    // counts solutions up to count_limit. values is left as the first
+    // solution found, if any.
+    // returns the number of solutions found
+    int solve(uint8_t *values, int count_limit) {
+        if (start(values, count_limit)) {
+            search_in_place(0);
+        }
+        if (n_solutions > 0) {
+            memcpy(values, first_solution, size::CELLS);
+        }
+        return n_solutions;
+    }
+
+    // Sets up the board from values (0 for blanks) and propagates the
+    // clues, leaving the root of the search to store or search.
+    // returns false if the clues contradict each other
+    bool start(const uint8_t *values, int count_limit) {
+        this->count_limit = count_limit > 1 ? count_limit : 1;
+        n_solutions = 0;
+        expansion_count = 0;
+        stop = NULL;
+        root_depth = 0;
+        trail.clear();
+
+        bitset_t needs_reprocessing;
+        needs_reprocessing.clear();
+        for (int i = 0; i < size::CELLS; i++) {
+            board[i] = values[i];
+            domain[i] = values[i] ? (domain_t)(1 << values[i])
+                                  : (domain_t)size::ALL_VALUES;
+        }
+        for (int i = 0; i < size::CELLS; i++) {
+            if (!board[i]) {
+                continue;
+            }
+            // clues that conflict would send the search through everything
+            for (int peer_i = 0; peer_i < size::N_PEERS; peer_i++) {
+                if (board[TABLES.peers[i][peer_i]] == board[i]) {
+                    return false;
+                }
+            }
+            needs_reprocessing.insert(i);
+        }
+        return run_constraint_update(&needs_reprocessing);
+    }
+
+    // the board as it is now, after the guesses since start or load
+    void store(subtree_t *subtree) {
+        memcpy(subtree->board, board, sizeof(board));
+        memcpy(subtree->domain, domain, sizeof(domain));
+        subtree->depth = root_depth;
+    }
+
+    // Takes over subtree to split or search, counting solutions and
+    // expansions from 0. stop, if not NULL, cancels the search once set.
+    void load(const subtree_t *subtree, int count_limit,
+              const std::atomic<bool> *stop) {
+        memcpy(board, subtree->board, sizeof(board));
+        memcpy(domain, subtree->domain, sizeof(domain));
+        this->count_limit = count_limit > 1 ? count_limit : 1;
+        this->stop = stop;
+        root_depth = subtree->depth;
+        n_solutions = 0;
+        expansion_count = 0;
+        trail.clear();
+    }
+
+    // Tries each value of the loaded board's decision cell, adding the
+    // children still open to children, lowest value last.
+    // returns the number of children, or the board itself, solved outright
+    int split(std::vector<subtree_t> *children) {
+        int i = find_decision_cell();
+        if (i == -1) {
+            record_solution();
+            return n_solutions;
+        }
+        expansion_count++;
+
+        uint32_t options = domain[i];
+        size_t first_child = children->size();
+        size_t trail_mark = trail.size();
+        while (options) {
+            int value = __builtin_ctz(options);
+            options &= options - 1;
+
+            bitset_t needs_reprocessing;
+            needs_reprocessing.clear();
+            place(&needs_reprocessing, i, value);
+            STATS_ADD(guesses, 1);
+            STATS_MAX(max_depth, root_depth + 1);
+            if (!run_constraint_update(&needs_reprocessing)) {
+                STATS_ADD(backtracks, 1);
+            } else if (find_decision_cell() == -1) {
+                record_solution();
+            } else {
+                children->push_back(subtree_t());
+                store(&children->back());
+                children->back().depth = root_depth + 1;
+            }
+            undo(trail_mark);
+        }
+        // the shared stack pops from the back, so the lowest value's
+        // child is searched first, as it is in place
+        std::reverse(children->begin() + first_child, children->end());
+        return n_solutions;
+    }
+
+    // Searches below the loaded board, as solve does.
+    // returns the number of solutions found
+    int search() {
+        search_in_place(root_depth);
+        return n_solutions;
+    }
+
+    // the first solution found since start or load
+    const uint8_t *solution() {
+        return first_solution;
+    }
+
+    int32_t expansions() {
+        return expansion_count;
+    }
+
+ private:
+    // Old contents of one cell, saved before it changes
+    typedef struct trail_entry {
+        uint16_t i;
+        uint8_t board;
+        domain_t domain;
+    } trail_entry_t;
+
+    uint8_t board[size::CELLS];
+    domain_t domain[size::CELLS];
+    std::vector<trail_entry_t> trail;
+    int count_limit;
+    int n_solutions;
+    uint8_t first_solution[size::CELLS];
+    int32_t expansion_count;
+    // optional, another thread sets it to cancel the search
+    const std::atomic<bool> *stop;
+    // guesses made before the board that start or load set up
+    int root_depth;
+
+    void save(int i) {
+        trail_entry_t entry = { (uint16_t)i, board[i], domain[i] };
+        trail.push_back(entry);
+    }
+
+    void undo(size_t trail_size) {
+        while (trail.size() > trail_size) {
+            trail_entry_t &entry = trail.back();
+            board[entry.i] = entry.board;
+            domain[entry.i] = entry.domain;
+            trail.pop_back();
+        }
+    }
+
+    // places value in unsolved cell i
+    void place(bitset_t *needs_reprocessing, int i, int value) {
+        save(i);
+        board[i] = value;
+        domain[i] = 1 << value;
+        needs_reprocessing->insert(i);
+    }
+
+    // Removes the value of solved cell i from its peers, solving those
+    // left with one option.
+    // returns false if a peer is left with nothing, or already holds it
+    bool eliminate_from_peers(bitset_t *needs_reprocessing, int i) {
+        domain_t mask = domain[i];
+        const uint16_t *peers = TABLES.peers[i];
+        for (int peer_i = 0; peer_i < size::N_PEERS; peer_i++) {
+            int j = peers[peer_i];
+            if (!(domain[j] & mask)) {
+                continue;
+            }
+            if (board[j]) {
+                return false;
+            }
+            save(j);
+            domain[j] &= ~mask;
+            if (domain[j] == 0) {
+                return false;
+            }
+            if ((domain[j] & (domain[j] - 1)) == 0) {
+                board[j] = __builtin_ctz(domain[j]);
+                needs_reprocessing->insert(j);
+            }
+        }
+        return true;
+    }
+
+    bool run_ac3(bitset_t *needs_reprocessing) {
+        while (!needs_reprocessing->empty()) {
+            int i = needs_reprocessing->pop();
+            STATS_ADD(ac3_pops, 1);
+            if (!eliminate_from_peers(needs_reprocessing, i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // places every value that only one cell of a section can take,
+    // until there are none
+    // returns false if a value has no place left in some section
+    bool run_only_viable(bitset_t *needs_reprocessing) {
+        bool found_any = true;
+        while (found_any) {
+            found_any = false;
+            for (int section_i = 0; section_i < size::N_SECTIONS;
+                 section_i++) {
+                const uint16_t *section = TABLES.sections[section_i];
+                uint32_t any = 0;
+                uint32_t multiple = 0;
+                uint32_t solved = 0;
+                for (int k = 0; k < size::SIDE; k++) {
+                    int i = section[k];
+                    if (!board[i]) {
+                        multiple |= any & domain[i];
+                        any |= domain[i];
+                    } else {
+                        solved |= domain[i];
+                    }
+                }
+                if ((any | solved) != size::ALL_VALUES) {
+                    return false;
+                }
+                uint32_t singles = any & ~multiple;
+                while (singles) {
+                    int value = __builtin_ctz(singles);
+                    singles &= singles - 1;
+                    for (int k = 0; k < size::SIDE; k++) {
+                        int i = section[k];
+                        if (!board[i] && (domain[i] & (1 << value))) {
+                            STATS_ADD(hidden_singles, 1);
+                            place(needs_reprocessing, i, value);
+                            found_any = true;
+                            if (!run_ac3(needs_reprocessing)) {
+                                return false;
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Finds n unsolved cells of a section sharing the same n values,
+    // and removes those values from the section's other cells. Cells left
+    // with one option are placed and queued in needs_reprocessing.
+    // returns true if it changed any domain
+    bool run_n_domain_reduction(bitset_t *needs_reprocessing) {
+        bool made_change = false;
+        for (int section_i = 0; section_i < size::N_SECTIONS; section_i++) {
+            const uint16_t *section = TABLES.sections[section_i];
+            uint32_t needs_examination = 0;
+            for (int k = 0; k < size::SIDE; k++) {
+                if (!board[section[k]]) {
+                    needs_examination |= (uint32_t)1 << k;
+                }
+            }
+            int n_open = __builtin_popcount(needs_examination);
+
+            while (needs_examination) {
+                int k = __builtin_ctz(needs_examination);
+                domain_t subset = domain[section[k]];
+                uint32_t found = 0;
+                for (uint32_t rest = needs_examination; rest;
+                     rest &= rest - 1) {
+                    int k2 = __builtin_ctz(rest);
+                    if (domain[section[k2]] == subset) {
+                        found |= (uint32_t)1 << k2;
+                    }
+                }
+                needs_examination &= ~found;
+
+                int n_found = __builtin_popcount(found);
+                if (n_found != __builtin_popcount(subset) ||
+                    n_found == 1 || n_found == n_open) {
+                    continue;
+                }
+                for (int k2 = 0; k2 < size::SIDE; k2++) {
+                    int i = section[k2];
+                    if (board[i] || domain[i] == subset ||
+                        !(domain[i] & subset)) {
+                        continue;
+                    }
+                    save(i);
+                    domain[i] &= ~subset;
+                    STATS_ADD(subset_reductions, 1);
+                    made_change = true;
+                    if (domain[i] && !(domain[i] & (domain[i] - 1))) {
+                        board[i] = __builtin_ctz(domain[i]);
+                        needs_reprocessing->insert(i);
+                    }
+                }
+            }
+        }
+        return made_change;
+    }
+
+    bool is_solveable() {
+        for (int i = 0; i < size::CELLS; i++) {
+            if (!board[i] && domain[i] == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // returns true if board is valid, false if inconsistent
+    bool run_constraint_update(bitset_t *needs_reprocessing) {
+        do {
+            if (!run_ac3(needs_reprocessing) ||
+                !run_only_viable(needs_reprocessing)) {
+                return false;
+            }
+        } while (run_n_domain_reduction(needs_reprocessing));
+        return is_solveable();
+    }
+
+    void record_solution() {
+        if (n_solutions == 0) {
+            memcpy(first_solution, board, size::CELLS);
+        }
+        n_solutions++;
+    }
+
+    // the unsolved cell with the fewest options, or -1 if all are solved
+    int find_decision_cell() {
+        int best_i = -1;
+        int best_count = size::SIDE + 1;
+        for (int i = 0; i < size::CELLS; i++) {
+            if (board[i]) {
+                continue;
+            }
+            int count = __builtin_popcount(domain[i]);
+            if (count <= 2) {
+                return i;
+            }
+            if (count < best_count) {
+                best_i = i;
+                best_count = count;
+            }
+        }
+        return best_i;
+    }
+
+    // as the 9x9 search_in_place in sudoku_search.cpp
+    // returns true once count_limit solutions are found
+    bool search_in_place(int depth) {
+        int i = find_decision_cell();
+        if (i == -1) {
+            record_solution();
+            return n_solutions >= count_limit;
+        }
+        expansion_count++;
+
+        uint32_t options = domain[i];
+        while (options) {
+            if (stop && stop->load(std::memory_order_relaxed)) {
+                return false;
+            }
+            int value = __builtin_ctz(options);
+            options &= options - 1;
+
+            size_t trail_mark = trail.size();
+            bitset_t needs_reprocessing;
+            needs_reprocessing.clear();
+            place(&needs_reprocessing, i, value);
+            STATS_ADD(guesses, 1);
+            STATS_MAX(max_depth, depth + 1);
+
+            bool normal = run_constraint_update(&needs_reprocessing);
+            if (normal && search_in_place(depth + 1)) {
+                return true;
+            }
+            undo(trail_mark);
+            if (!normal) {
+                STATS_ADD(backtracks, 1);
+            }
+        }
+        return false;
+    }
+};
+
+template <int BOX>
+constexpr nxn_tables<BOX> nxn_solver<BOX>::TABLES;
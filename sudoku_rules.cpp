@@ -0,0 +1,369 @@
+#include "sudoku.h"
+#include "sudoku_tables.h"
+
+#include <stdint.h>
+
+// The propagation rules beyond singles and identical-domain subsets, which
+// run_constraint_update falls back on when those stall and options->rules
+// asks for them. Each one only removes candidates. A cell left with one is
+// solved and taken from its peers by run_ac3 right away, as
+// run_only_viable does, so every rule sees a consistent board.
+// Each rule returns false if it found the board inconsistent, and sets
+// *made_change if it changed any domain.
+
+// With PROPAGATE_ADAPTIVE, a rule that finds nothing is skipped for twice
+// as many calls as the last time it found nothing, up to this many
+#define RULE_MAX_BACKOFF 64
+
+// the rules in the order they are tried, cheapest first
+enum {
+    RULE_LOCKED_CANDIDATES,
+    RULE_SUBSETS,
+    RULE_FISH,
+    N_RULES,
+};
+
+// PROPAGATE_ADAPTIVE's record of whether a rule has been paying off
+typedef struct rule_schedule {
+    // calls left to skip the rule for
+    int skip;
+    // what skip is set to the next time the rule finds nothing
+    int backoff;
+} rule_schedule_t;
+
+// per thread, so the searches of one batch learn from each other
+static thread_local rule_schedule_t schedules[N_RULES] = {
+    { 0, 1 }, { 0, 1 }, { 0, 1 },
+};
+
+// Takes the values of remove out of cell i's domain, if it is unsolved.
+// returns false if that left the board inconsistent
+static bool remove_candidates(char *board, uint16_t *board_domain,
+                              uint64_t *needs_reprocessing, int i,
+                              uint16_t remove, trail_t *trail,
+                              bool *made_change) {
+    if (board[i] != 0 || !(board_domain[i] & remove)) {
+        return true;
+    }
+    trail_save(trail, board, board_domain, i);
+    board_domain[i] &= ~remove;
+    sections_mark_dirty(needs_reprocessing, TABLES.cell_section_bits[i]);
+    *made_change = true;
+    if (board_domain[i] == 0) {
+        return false;
+    }
+    if (count_on_bits(board_domain[i]) == 1) {
+        board[i] = which_on_bit(board_domain[i]);
+        reprocessing_insert(needs_reprocessing, i);
+        return run_ac3(board, board_domain, needs_reprocessing, trail);
+    }
+    return true;
+}
+
+// Fills places[v] with a bit for each position in section whose cell is
+// unsolved and can still be v.
+// returns the values some unsolved cell of the section can still be
+static uint16_t value_places(char *board, uint16_t *board_domain,
+                             const uint8_t *section, uint16_t *places) {
+    uint16_t open_values = 0;
+    for (int v = 1; v <= 9; v++) {
+        places[v] = 0;
+    }
+    for (int k = 0; k < 9; k++) {
+        int i = section[k];
+        if (board[i] != 0) {
+            continue;
+        }
+        uint16_t options = board_domain[i];
+        open_values |= options;
+        while (options) {
+            int v = which_on_bit(options);
+            options &= options - 1;
+            places[v] |= 1 << k;
+        }
+    }
+    return open_values;
+}
+
+// the three position masks of a section that each fall in one line of a
+// box (for boxes: its rows, then its columns) or in one box (for lines)
+static const uint16_t THIRDS[2][3] = {
+    { 0x007, 0x038, 0x1c0 },
+    { 0x049, 0x092, 0x124 },
+};
+
+// removes v from the cells of section `to` outside of section `from`
+static bool remove_outside(char *board, uint16_t *board_domain,
+                           uint64_t *needs_reprocessing, int to, int from,
+                           int v, trail_t *trail, bool *made_change) {
+    const uint8_t *section = TABLES.sections[to];
+    for (int k = 0; k < 9; k++) {
+        int i = section[k];
+        const uint8_t *cell_sections = TABLES.cell_sections[i];
+        if (cell_sections[0] == from || cell_sections[1] == from ||
+                cell_sections[2] == from || board[i] != 0 ||
+                !(board_domain[i] & (1 << v))) {
+            continue;
+        }
+        STATS_ADD(locked_candidates, 1);
+        if (!remove_candidates(board, board_domain, needs_reprocessing,
+                               i, 1 << v, trail, made_change)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Locked candidates. When a value's places in a box all fall in one row or
+// column, the rest of that line can't have it (pointing), and when its
+// places in a row or column all fall in one box, the rest of the box can't
+// (claiming).
+bool run_locked_candidates(char *board, uint16_t *board_domain,
+                           uint64_t *needs_reprocessing, trail_t *trail,
+                           bool *made_change) {
+    uint16_t places[10];
+    for (int s = 0; s < 27; s++) {
+        uint16_t open_values = value_places(board, board_domain,
+                                            TABLES.sections[s], places);
+        while (open_values) {
+            int v = which_on_bit(open_values);
+            open_values &= open_values - 1;
+            if (count_on_bits(places[v]) < 2) {
+                // a hidden single, which run_only_viable places
+                continue;
+            }
+            // the section the places all fall in, if any
+            int to = -1;
+            for (int t = 0; t < 3; t++) {
+                if (s >= 18) {
+                    int box = s - 18;
+                    if (!(places[v] & ~THIRDS[0][t])) {
+                        to = (box / 3) * 3 + t;
+                    } else if (!(places[v] & ~THIRDS[1][t])) {
+                        to = 9 + (box % 3) * 3 + t;
+                    }
+                } else if (!(places[v] & ~THIRDS[0][t])) {
+                    // positions along a row are columns, and along a
+                    // column rows, so a third of either is one box
+                    int line = s % 9;
+                    to = 18 + (s < 9 ? (line / 3) * 3 + t
+                                     : t * 3 + line / 3);
+                }
+            }
+            if (to != -1 && !remove_outside(board, board_domain,
+                                            needs_reprocessing, to, s, v,
+                                            trail, made_change)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Calls found(chosen, merged) for every set of `size` of masks[] (from
+// index `from` on), each nonzero, whose union has exactly size bits.
+// chosen holds the indexes picked as a bitmask and merged their union.
+// Sets are cut off as soon as their union goes over size bits.
+// returns false as soon as found does
+template <class Found>
+bool each_subset(const uint16_t *masks, int n_masks, int from, int size,
+                 uint16_t chosen, uint16_t merged, Found &found) {
+    int n_chosen = count_on_bits(chosen);
+    if (n_chosen == size) {
+        return count_on_bits(merged) != size || found(chosen, merged);
+    }
+    for (int k = from; k <= n_masks - (size - n_chosen); k++) {
+        uint16_t next = merged | masks[k];
+        if (!masks[k] || count_on_bits(next) > size) {
+            continue;
+        }
+        if (!each_subset(masks, n_masks, k + 1, size, chosen | (1 << k),
+                         next, found)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Naked and hidden subsets of 2 to 4 cells in one section, which
+// run_n_domain_reduction only finds when the cells' domains are identical.
+// A naked subset is n cells that together only have n values, which
+// the rest of the section can't have, as with [2, 3], [3, 4], [2, 4].
+// A hidden subset is n values that only n cells can have, which then
+// can't be anything else. One of size n covers the naked subset of the
+// other open cells, so bigger ones aren't needed.
+// The domains and places looked at aren't updated as changes are made,
+// which can only make the subsets found weaker, never wrong.
+bool run_subsets(char *board, uint16_t *board_domain,
+                 uint64_t *needs_reprocessing, trail_t *trail,
+                 bool *made_change) {
+    for (int s = 0; s < 27; s++) {
+        const uint8_t *section = TABLES.sections[s];
+        uint16_t domains[9];
+        int n_open = 0;
+        for (int k = 0; k < 9; k++) {
+            int i = section[k];
+            domains[k] = board[i] == 0 ? board_domain[i] : 0;
+            n_open += board[i] == 0;
+        }
+        uint16_t places[10];
+        value_places(board, board_domain, section, places);
+
+        // the values of cells, from the rest of the section
+        auto naked = [&](uint16_t cells, uint16_t values) {
+            for (int k = 0; k < 9; k++) {
+                int i = section[k];
+                if (cells & (1 << k) || board[i] != 0 ||
+                        !(board_domain[i] & values)) {
+                    continue;
+                }
+                STATS_ADD(general_subsets, 1);
+                if (!remove_candidates(board, board_domain,
+                                       needs_reprocessing, i, values, trail,
+                                       made_change)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        // everything but values, from cells
+        auto hidden = [&](uint16_t values, uint16_t cells) {
+            for (int k = 0; k < 9; k++) {
+                int i = section[k];
+                if (!(cells & (1 << k)) || board[i] != 0 ||
+                        !(board_domain[i] & ~values)) {
+                    continue;
+                }
+                STATS_ADD(general_subsets, 1);
+                if (!remove_candidates(board, board_domain,
+                                       needs_reprocessing, i, ~values, trail,
+                                       made_change)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        for (int size = 2; size <= 4 && size * 2 <= n_open; size++) {
+            // places has index 0 unused, as values start from 1
+            if (!each_subset(domains, 9, 0, size, 0, 0, naked) ||
+                    !each_subset(places, 10, 1, size, 0, 0, hidden)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// X-wings (2 lines) and swordfish (3). When a value's places in n rows all
+// fall within n columns, each of those columns has it in one of those rows,
+// so the rest of the columns can't have it. The same goes with rows and
+// columns swapped. As in run_subsets, the places aren't kept up to date.
+bool run_fish(char *board, uint16_t *board_domain,
+              uint64_t *needs_reprocessing, trail_t *trail,
+              bool *made_change) {
+    for (int v = 1; v <= 9; v++) {
+        // rows then columns as the base lines
+        for (int base = 0; base < 2; base++) {
+            uint16_t lines[9];
+            for (int line = 0; line < 9; line++) {
+                lines[line] = 0;
+                for (int k = 0; k < 9; k++) {
+                    int i = base == 0 ? line * 9 + k : k * 9 + line;
+                    if (board[i] == 0 && (board_domain[i] & (1 << v))) {
+                        lines[line] |= 1 << k;
+                    }
+                }
+            }
+            auto fish = [&](uint16_t chosen, uint16_t covered) {
+                for (int line = 0; line < 9; line++) {
+                    if (chosen & (1 << line)) {
+                        continue;
+                    }
+                    uint16_t remove = lines[line] & covered;
+                    while (remove) {
+                        int k = which_on_bit(remove);
+                        remove &= remove - 1;
+                        int i = base == 0 ? line * 9 + k : k * 9 + line;
+                        if (board[i] != 0 || !(board_domain[i] & (1 << v))) {
+                            continue;
+                        }
+                        STATS_ADD(fish, 1);
+                        if (!remove_candidates(board, board_domain,
+                                               needs_reprocessing, i,
+                                               1 << v, trail,
+                                               made_change)) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            };
+            for (int size = 2; size <= 3; size++) {
+                if (!each_subset(lines, 9, 0, size, 0, 0, fish)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Runs the rules of `rules` (PROPAGATE_*) cheapest first, stopping at the
+// first that changes anything, so the cheaper ones get another go before
+// the next costly one. With PROPAGATE_ADAPTIVE, a rule that keeps finding
+// nothing is skipped for more and more calls, and tried every time again
+// once it finds something.
+// returns false if the board turned out inconsistent
+bool run_extra_rules(char *board, uint16_t *board_domain,
+                     uint64_t *needs_reprocessing, trail_t *trail,
+                     uint32_t rules, bool *made_change) {
+    static const uint32_t RULE_FLAGS[N_RULES] = {
+        PROPAGATE_LOCKED_CANDIDATES, PROPAGATE_SUBSETS, PROPAGATE_FISH,
+    };
+    bool adaptive = rules & PROPAGATE_ADAPTIVE;
+    *made_change = false;
+    for (int r = 0; r < N_RULES; r++) {
+        if (!(rules & RULE_FLAGS[r])) {
+            continue;
+        }
+        rule_schedule_t *schedule = &schedules[r];
+        if (adaptive && schedule->skip > 0) {
+            schedule->skip--;
+            continue;
+        }
+
+        STATS_TIMER(rule_start);
+        bool normal;
+        switch (r) {
+        case RULE_LOCKED_CANDIDATES:
+            normal = run_locked_candidates(board, board_domain,
+                                           needs_reprocessing, trail,
+                                           made_change);
+            break;
+        case RULE_SUBSETS:
+            normal = run_subsets(board, board_domain, needs_reprocessing,
+                                 trail, made_change);
+            break;
+        default:
+            normal = run_fish(board, board_domain, needs_reprocessing,
+                              trail, made_change);
+            break;
+        }
+        STATS_TIME(rule_start, extra_rules_seconds);
+
+        if (!normal) {
+            return false;
+        }
+        if (*made_change) {
+            schedule->backoff = 1;
+            return true;
+        }
+        if (adaptive) {
+            schedule->skip = schedule->backoff;
+            if (schedule->backoff < RULE_MAX_BACKOFF) {
+                schedule->backoff *= 2;
+            }
+        }
+    }
+    return true;
+}
@@ -1,66 +1,283 @@
 #include "sudoku.h"
+#include "frontiers.h"
+#include "search_engine.h"
+#include "sudoku_tables.h"
+#include "visited_sets.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::condition_variable;
+using std::lock_guard;
+using std::mutex;
+using std::thread;
+using std::unique_lock;
+using std::vector;
+
+// sudoku_search_parallel keeps splitting subtrees near the root until
+// there are this many waiting per thread, so idle threads have work to take
+#define PARALLEL_SPLIT_FACTOR 4
+
+// marks the solved cells in an mrv_index
+#define MRV_SOLVED 10
+
+// The cells of a board grouped by how many candidates they have left,
+// so the search finds its next cell, dead ends, and solved boards with
+// a few bit operations rather than by scanning the board. It is brought
+// up to date from the trail, which saves every cell propagation changes.
+typedef struct mrv_index {
+    // by_count[k] has the unsolved cells with k candidates (none with 0,
+    // short of a dead end), and by_count[MRV_SOLVED] the solved cells.
+    // Split over two 64-bit ints like needs_reprocessing.
+    uint64_t by_count[MRV_SOLVED + 1][2];
+    // which of by_count each cell is in
+    uint8_t count[81];
+} mrv_index_t;
+
+// puts cell i in the group its board and board_domain now call for
+inline void mrv_index_set(mrv_index_t *index, char *board,
+                          uint16_t *board_domain, int i) {
+    int count = board[i] != 0 ? MRV_SOLVED : count_on_bits(board_domain[i]);
+    uint64_t bit = (uint64_t)1 << (i & 63);
+    index->by_count[index->count[i]][i >> 6] &= ~bit;
+    index->by_count[count][i >> 6] |= bit;
+    index->count[i] = count;
+}
+
+void mrv_index_build(mrv_index_t *index, char *board,
+                     uint16_t *board_domain) {
+    memset(index->by_count, 0, sizeof(index->by_count));
+    for (int i = 0; i < 81; i++) {
+        int count = board[i] != 0 ? MRV_SOLVED
+                                  : count_on_bits(board_domain[i]);
+        reprocessing_insert(index->by_count[count], i);
+        index->count[i] = count;
+    }
+}
+
+// updates the cells the trail saved from entry first on. A cell can be
+// saved several times, but it ends up in the same group each time.
+void mrv_index_update(mrv_index_t *index, trail_t *trail, int first,
+                      char *board, uint16_t *board_domain) {
+    for (int k = first; k < trail->size; k++) {
+        mrv_index_set(index, board, board_domain, trail->entries[k].i);
+    }
+}
+
+// the lowest cell of cells, a two word bitset, or -1 when it is empty
+inline int lowest_cell(const uint64_t *cells) {
+    if (cells[0]) {
+        return which_on_bit64(cells[0]);
+    }
+    return cells[1] ? which_on_bit64(cells[1]) + 64 : -1;
+}
 
 typedef struct sudoku_state {
     char board[81];
     uint16_t board_domain[81];
+    // of board and board_domain, kept up to date by next_new_state
+    mrv_index_t index;
+    // where this state and its children are allocated from,
+    // or NULL to use malloc and free
+    pool_t *pool;
+    // guesses made to reach this state
+    int depth;
+    // optional, shared by the whole search. next_new_state records each
+    // child's propagation in it to update hash from the cells it solved.
+    trail_t *trail;
+    // Zobrist hash of board, see board_hash, kept only with a trail
+    uint64_t hash;
+    branching_t branching;
+    // PROPAGATE_* rules to use after each guess
+    uint32_t rules;
 } sudoku_state_t;
 
-// looks for unsolved cells that have a domain of 0
-// this indicates an impossible board state
-bool is_board_solveable(char *board, uint16_t *board_domain) {
+sudoku_state_t *alloc_state(pool_t *pool) {
+    if (pool) {
+        return (sudoku_state_t*)pool_alloc(pool);
+    }
+    return (sudoku_state_t*)malloc(sizeof(sudoku_state_t));
+}
+
+void free_state(sudoku_state_t *state) {
+    if (state->pool) {
+        pool_free(state->pool, state);
+    } else {
+        free(state);
+    }
+}
+
+// false when an unsolved cell has a domain of 0,
+// which indicates an impossible board state
+bool is_state_solveable(sudoku_state_t *state) {
+    return !(state->index.by_count[0][0] | state->index.by_count[0][1]);
+}
+
+bool is_state_goal(sudoku_state_t *state) {
+    const uint64_t *solved = state->index.by_count[MRV_SOLVED];
+    return solved[0] == ~(uint64_t)0 &&
+           solved[1] == ((uint64_t)1 << (81 - 64)) - 1;
+}
+
+bool is_goal(gen_search_node_t *node) {
+    return is_state_goal((sudoku_state_t*)node->state);
+}
+
+uint64_t board_hash(char *board) {
+    uint64_t hash = 0;
     for (int i = 0; i < 81; i++) {
-        if (board[i] != 0) {
+        hash ^= TABLES.zobrist[i][(int)board[i]];
+    }
+    return hash;
+}
+
+// What board_hash changes by for the cells the trail saved as unsolved,
+// which board now has solved. A cell can be saved several times, with
+// its domain shrinking, but it is only counted once.
+uint64_t trail_hash_delta(trail_t *trail, char *board) {
+    uint64_t counted[2] = { 0, 0 };
+    uint64_t delta = 0;
+    for (int k = 0; k < trail->size; k++) {
+        trail_entry_t *entry = &trail->entries[k];
+        if (entry->board != 0 || reprocessing_contains(counted, entry->i)) {
             continue;
         }
-        if (board_domain[i] == 0) {
-            return false;
+        reprocessing_insert(counted, entry->i);
+        delta ^= TABLES.zobrist[entry->i][(int)board[entry->i]];
+    }
+    return delta;
+}
+
+// the fewest places number has left in any of cell i's sections
+int fewest_places(uint16_t *board_domain, int i, int number) {
+    int fewest = 9;
+    for (int s = 0; s < 3; s++) {
+        const uint8_t *section = TABLES.sections[TABLES.cell_sections[i][s]];
+        int places = 0;
+        for (int k = 0; k < 9; k++) {
+            places += (board_domain[section[k]] >> number) & 1;
+        }
+        if (places < fewest) {
+            fewest = places;
         }
     }
-    return true;
+    return fewest;
 }
 
-bool is_state_solveable(sudoku_state_t *state) {
-    return is_board_solveable(state->board, state->board_domain);
+// how many unsolved peers of cell i still have number as a candidate
+int peers_with(char *board, uint16_t *board_domain, int i, int number) {
+    int count = 0;
+    for (int k = 0; k < 20; k++) {
+        int j = TABLES.peers[i][k];
+        count += board[j] == 0 && ((board_domain[j] >> number) & 1);
+    }
+    return count;
 }
 
-bool is_goal(gen_search_node_t *node) {
-    sudoku_state_t *state = (sudoku_state_t*)node->state;
-    for (int i = 0; i < 81; i++) {
-        if (state->board[i] == 0) {
-            return false;
+// the tie-breaker of the MRV cell orders, lower is better
+int cell_tie_score(char *board, uint16_t *board_domain, uint64_t *open,
+                   int i, cell_order_t order) {
+    if (order == CELL_ORDER_MRV_DEGREE) {
+        // the most unsolved peers, as a negative to sort first
+        return -(__builtin_popcountll(TABLES.peer_bits[i][0] & open[0]) +
+                 __builtin_popcountll(TABLES.peer_bits[i][1] & open[1]));
+    }
+    int fewest = 9;
+    uint16_t options = board_domain[i];
+    while (options) {
+        int number = which_on_bit(options);
+        options &= options - 1;
+        int places = fewest_places(board_domain, i, number);
+        if (places < fewest) {
+            fewest = places;
         }
     }
-    return true;
+    return fewest;
 }
 
-void find_decision_cell(char *board, uint16_t *board_domain,
-                        int *i, int *number) {
-    // use the first with only two items in domain
-    // if or the smallest number of items in domain
+// the unsolved cell to guess at next, or -1 when there are none
+int find_decision_cell(mrv_index_t *index, char *board,
+                       uint16_t *board_domain, cell_order_t order) {
+    uint64_t (*by_count)[2] = index->by_count;
+    // an unsolved cell left with one item (n_domain_reduction doesn't
+    // place these) is taken right away, as a guess that can't be wrong
+    if (order == CELL_ORDER_FIRST) {
+        // use the first with only two items in domain
+        // if or the first with the smallest number of items in domain
+        uint64_t few[2] = {
+            by_count[0][0] | by_count[1][0] | by_count[2][0],
+            by_count[0][1] | by_count[1][1] | by_count[2][1],
+        };
+        int i = lowest_cell(few);
+        for (int count = 3; i == -1 && count < MRV_SOLVED; count++) {
+            i = lowest_cell(by_count[count]);
+        }
+        return i;
+    }
+
+    // the smallest domains first, then the tie-breaker among just those
+    int best_count = 0;
+    while (best_count < MRV_SOLVED &&
+            !(by_count[best_count][0] | by_count[best_count][1])) {
+        best_count++;
+    }
+    if (best_count == MRV_SOLVED) {
+        return -1;
+    }
+    if (best_count <= 1) {
+        return lowest_cell(by_count[best_count]);
+    }
 
+    uint64_t open[2] = {
+        ~by_count[MRV_SOLVED][0],
+        ~by_count[MRV_SOLVED][1] & (((uint64_t)1 << (81 - 64)) - 1),
+    };
     int best_i = -1;
-    int best_count = -1;
-    for (int j = 0; j < 81; j++) {
-        if (board[j] != 0) {
-            continue;
-        }
-        int count = count_on_bits(board_domain[j]);
-        if (count == 2) {
-            *i = j;
-            *number = which_on_bit(board_domain[j]);
-            return;
-        } else if (count > 2 && (best_i == -1 || count < best_count)) {
+    int best_score = 0;
+    uint64_t candidates[2] = { by_count[best_count][0],
+                               by_count[best_count][1] };
+    while (candidates[0] || candidates[1]) {
+        int j = reprocessing_pop(candidates);
+        int score = cell_tie_score(board, board_domain, open, j, order);
+        if (best_i == -1 || score < best_score) {
             best_i = j;
-            best_count = count;
+            best_score = score;
         }
     }
+    return best_i;
+}
 
-    *i = best_i;
-    *number = which_on_bit(board_domain[best_i]);
+// the value of options, cell i's candidates not yet tried, to try next.
+// With last, the one of them it would try last instead, so going through
+// options that way gives the same order backwards.
+int choose_value(char *board, uint16_t *board_domain, int i,
+                 uint16_t options, value_order_t order, bool last) {
+    if (order == VALUE_ORDER_LOWEST || count_on_bits(options) == 1) {
+        return last ? 31 - __builtin_clz(options) : which_on_bit(options);
+    }
+    int best_number = 0;
+    int best_score = 0;
+    while (options) {
+        int number = which_on_bit(options);
+        options &= options - 1;
+        int score = order == VALUE_ORDER_LEAST_CONSTRAINING ?
+                        peers_with(board, board_domain, i, number) :
+                        fewest_places(board_domain, i, number);
+        // ties go to the lower value first, so to the higher one last
+        if (best_number == 0 ||
+                (last ? score >= best_score : score < best_score)) {
+            best_number = number;
+            best_score = score;
+        }
+    }
+    return best_number;
 }
 
 void *expand_state(void *state) {
@@ -75,8 +292,7 @@ void *expand_state(void *state) {
     // print_board(s->board);
     // printf("\r");
 
-    sudoku_state_t *expansion =
-                        (sudoku_state_t*)calloc(1, sizeof(sudoku_state_t));
+    sudoku_state_t *expansion = alloc_state(s->pool);
     memcpy(expansion, s, sizeof(sudoku_state_t));
     return expansion;
 }
@@ -88,70 +304,271 @@ bool next_new_state(void *expansion, void **new_state, int32_t *new_action) {
 
     sudoku_state_t *expand = (sudoku_state_t*)expansion;
 
-    sudoku_state_t *state = (sudoku_state_t*)calloc(1, sizeof(sudoku_state_t));
+    sudoku_state_t *state = alloc_state(expand->pool);
+    // so it can be freed even if the loop below never fills it in
+    state->pool = expand->pool;
     // might have to attempt several times to find a valid child board
     while (is_state_solveable(expand)) {
         memcpy(state, expand, sizeof(sudoku_state_t));
 
-        int i;
-        int number;
-        find_decision_cell(state->board, state->board_domain, &i, &number);
+        int i = find_decision_cell(&state->index, state->board,
+                                   state->board_domain,
+                                   state->branching.cell_order);
         if (i == -1) {
             // completely solved the board in this process!
-            free(state);
-            free(expand);
+            free_state(state);
+            free_state(expand);
             return false;
         }
+        // expand's domain only loses the values already tried.
+        // The children go on a LIFO frontier (or split_subtree's stack),
+        // which takes the last made first, so they are made worst value
+        // first, for the values to be tried in the same order as in place
+        int number = choose_value(state->board, state->board_domain, i,
+                                  state->board_domain[i],
+                                  state->branching.value_order, true);
 
-        check_add(state->board, i, number);
+        uint64_t needs_reprocessing[REPROCESSING_WORDS] = { 0 };
+        check_add(state->board, needs_reprocessing, i, number);
         state->board[i] = number;
         state->board_domain[i] = 1 << number;
+        state->depth = expand->depth + 1;
+        STATS_ADD(guesses, 1);
+        STATS_MAX(max_depth, state->depth);
 
-        uint64_t needs_reprocessing[2] = { 0, 0 };
         reprocessing_insert(needs_reprocessing, i);
 
+        if (state->trail) {
+            state->trail->size = 0;
+        }
         bool normal = run_constraint_update(
                         state->board, state->board_domain,
-                        needs_reprocessing, get_all_sections());
+                        needs_reprocessing, state->trail, state->rules);
 
         // for later calls to this function, remove the option just tried
         expand->board_domain[i] &= ~(1 << number);
+        mrv_index_set(&expand->index, expand->board, expand->board_domain, i);
 
         if (normal) {
+            // the guess itself isn't on the trail
+            if (state->trail) {
+                mrv_index_set(&state->index, state->board,
+                              state->board_domain, i);
+                mrv_index_update(&state->index, state->trail, 0,
+                                 state->board, state->board_domain);
+            } else {
+                mrv_index_build(&state->index, state->board,
+                                state->board_domain);
+            }
+            if (state->trail) {
+                state->hash = expand->hash ^ TABLES.zobrist[i][number] ^
+                              trail_hash_delta(state->trail, state->board);
+            }
             *new_state = state;
             *new_action = -1;  // unused
             return true;
         }
+        STATS_ADD(backtracks, 1);
     }
-    free(state);
-    free(expand);
+    free_state(state);
+    free_state(expand);
     return false;
 }
 
 void destroy_state(void *state) {
-    free(state);
+    free_state((sudoku_state_t*)state);
 }
 
-void sudoku_search(char *board, uint16_t *board_domain, bool debug) {
+// Sudoku for the templated tree_search, so every call below
+// resolves (and can be inlined) at compile time
+class sudoku_search_problem {
+    // optional, another thread sets it to cancel the search
+    atomic<bool> *stop;
+ public:
+    sudoku_search_problem(atomic<bool> *stop) : stop(stop) {
+    }
+    bool is_goal(gen_search_node_t *node) {
+        return ::is_goal(node);
+    }
+    float step_cost(gen_search_node_t *node, int32_t action) {
+        return 1;
+    }
+    float ordering_cost(gen_search_node_t *node) {
+        return node->path_cost;
+    }
+    void *expand_state(void *state) {
+        return ::expand_state(state);
+    }
+    bool next_new_state(void *expansion,
+                        void **new_state, int32_t *new_action) {
+        return ::next_new_state(expansion, new_state, new_action);
+    }
+    // O(1), as next_new_state keeps each state's hash up to date
+    uint64_t calc_state_hash(void *state) {
+        return ((sudoku_state_t*)state)->hash;
+    }
+    uint64_t child_state_hash(uint64_t state_hash, void *state,
+                              void *new_state, int32_t action) {
+        return ((sudoku_state_t*)new_state)->hash;
+    }
+    void destroy_state(void *state) {
+        ::destroy_state(state);
+    }
+    bool should_stop() {
+        return stop && stop->load(std::memory_order_relaxed);
+    }
+};
+
+void init_sudoku_search(general_search_problem_t *p,
+                        sudoku_state_t *initial_state) {
+    p->allow_cycles = true;
+    p->use_node_pool = true;
+    p->initial_state = initial_state;
+}
+
+// Shared by the whole recursion of one search_in_place
+typedef struct in_place_search {
+    trail_t trail;
+    // optional, another thread sets it to cancel the search
+    atomic<bool> *stop;
+    int32_t expansion_count;
+    branching_t branching;
+    uint32_t rules;
+    // the search ends once it has found this many solutions
+    int solution_limit;
+    int n_solutions;
+    // optional, gets a copy of the first solution found
+    char *first_solution;
+} in_place_search_t;
+
+void init_in_place_search(in_place_search_t *search, atomic<bool> *stop,
+                          branching_t branching, uint32_t rules,
+                          int solution_limit, char *first_solution) {
+    trail_init(&search->trail);
+    search->stop = stop;
+    search->expansion_count = 0;
+    search->branching = branching;
+    search->rules = rules;
+    search->solution_limit = solution_limit;
+    search->n_solutions = 0;
+    search->first_solution = first_solution;
+}
+
+// Depth-first search that changes board and board_domain in place.
+// Each guess marks the trail, and a guess that fails is rolled back with
+// trail_undo rather than by keeping a copy of the board for every child.
+// Every solution is counted, and the search goes on to look for more
+// until search->solution_limit are found.
+// index is of board as it is now, and each guess updates a copy of it.
+// returns true when the limit is reached, leaving board as the last
+// solution, else false with the board as it was
+bool search_in_place(char *board, uint16_t *board_domain, mrv_index_t *index,
+                     in_place_search_t *search, int depth) {
+    int i = find_decision_cell(index, board, board_domain,
+                               search->branching.cell_order);
+    if (i == -1) {
+        // nothing left unsolved
+        if (search->n_solutions == 0 && search->first_solution) {
+            memcpy(search->first_solution, board, 81);
+        }
+        search->n_solutions++;
+        return search->n_solutions >= search->solution_limit;
+    }
+    search->expansion_count++;
+
+    trail_t *trail = &search->trail;
+    uint16_t options = board_domain[i];
+    while (options) {
+        if (search->stop &&
+                search->stop->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        // the board is back as it was after each try, so the order
+        // doesn't shift under the values still left
+        int number = choose_value(board, board_domain, i, options,
+                                  search->branching.value_order, false);
+        options &= ~(1 << number);
+
+        uint64_t needs_reprocessing[REPROCESSING_WORDS] = { 0 };
+        int trail_mark = trail->size;
+        check_add(board, needs_reprocessing, i, number);
+        trail_save(trail, board, board_domain, i);
+        board[i] = number;
+        board_domain[i] = 1 << number;
+        STATS_ADD(guesses, 1);
+        STATS_MAX(max_depth, depth + 1);
+
+        reprocessing_insert(needs_reprocessing, i);
+        bool normal = run_constraint_update(board, board_domain,
+                                            needs_reprocessing, trail,
+                                            search->rules);
+        if (normal) {
+            mrv_index_t child_index = *index;
+            mrv_index_update(&child_index, trail, trail_mark,
+                             board, board_domain);
+            if (search_in_place(board, board_domain, &child_index,
+                                search, depth + 1)) {
+                return true;
+            }
+        }
+        trail_undo(trail, trail_mark, board, board_domain);
+        if (!normal) {
+            STATS_ADD(backtracks, 1);
+        }
+    }
+    return false;
+}
+
+// sudoku_search with the generic tree_search, copying the state
+// for every child. With use_visited_set, states already expanded are
+// skipped, found by their Zobrist hashes.
+bool sudoku_tree_search(char *board, uint16_t *board_domain,
+                        solve_options_t *options, int32_t *expansion_count) {
+    bool debug = options->debug;
+    bool use_visited_set = options->use_visited_set;
+    // every state made during the search comes from here,
+    // and is released all together at the end
+    pool_t state_pool;
+    pool_init(&state_pool, sizeof(sudoku_state_t));
+    trail_t trail;
+
     sudoku_state_t state = { 0 };
     memcpy(state.board, board, sizeof(state.board));
     memcpy(state.board_domain, board_domain, sizeof(state.board_domain));
+    mrv_index_build(&state.index, board, board_domain);
+    state.pool = &state_pool;
+    state.branching = options->branching;
+    state.rules = options->rules;
+    if (use_visited_set) {
+        trail_init(&trail);
+        state.trail = &trail;
+        state.hash = board_hash(board);
+    }
 
     general_search_problem_t p = { 0 };
-    populate_with_lifo(&p);
-    p.allow_cycles = true;
-    p.initial_state = &state;
-    p.is_goal = is_goal;
-    p.expand_state = expand_state;
-    p.next_new_state = next_new_state;
-    p.destroy_state = destroy_state;
-    // p.step_cost = step_cost;
-
-    gen_search_node_t *goal_node = tree_search(&p);
+    init_sudoku_search(&p, &state);
+    sudoku_search_problem problem(NULL);
+    // every search leaves it empty, and reusing it keeps its memory
+    static thread_local lifo_frontier frontier;
+
+    gen_search_node_t *goal_node;
+    if (use_visited_set) {
+        p.allow_cycles = false;
+        hash_visited_set expanded_set;
+        goal_node = tree_search(&p, problem, frontier, expanded_set);
+        trail_destroy(&trail);
+    } else {
+        no_visited_set expanded_set;
+        goal_node = tree_search(&p, problem, frontier, expanded_set);
+    }
+    *expansion_count = p.expansion_count;
     if (!goal_node) {
-        printf("No solution found after expanding %d nodes\n",
-               p.expansion_count);
-        return;
+        if (debug) {
+            printf("No solution found after expanding %d nodes\n",
+                   p.expansion_count);
+        }
+        pool_destroy(&state_pool);
+        return false;
     }
 
     if (debug) {
@@ -165,5 +582,271 @@ void sudoku_search(char *board, uint16_t *board_domain, bool debug) {
     memcpy(board_domain, result_state->board_domain,
                          sizeof(result_state->board_domain));
 
-    general_search_result_destroy(&p, goal_node);
+    general_search_result_destroy(&p, problem, goal_node);
+    pool_destroy(&state_pool);
+    return true;
+}
+
+bool sudoku_search(char *board, uint16_t *board_domain,
+                   solve_options_t *options, solve_stats_t *stats) {
+    int32_t expansion_count = 0;
+    bool found;
+    if (options->use_tree_search) {
+        found = sudoku_tree_search(board, board_domain, options,
+                                   &expansion_count);
+    } else {
+        in_place_search_t search;
+        init_in_place_search(&search, NULL, options->branching,
+                             options->rules, 1, NULL);
+        mrv_index_t index;
+        mrv_index_build(&index, board, board_domain);
+        found = search_in_place(board, board_domain, &index, &search, 0);
+        expansion_count = search.expansion_count;
+        trail_destroy(&search.trail);
+
+        if (options->debug) {
+            if (found) {
+                printf("Found sol. in place after expanding %d nodes\n\n",
+                       expansion_count);
+            } else {
+                printf("No solution found after expanding %d nodes\n",
+                       expansion_count);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->expansion_count = expansion_count;
+    }
+    return found;
+}
+
+// Counts the solutions below board, stopping once limit are found.
+// Leaves board as the first solution found, if any.
+int sudoku_count(char *board, uint16_t *board_domain, int limit,
+                 solve_options_t *options, solve_stats_t *stats) {
+    char first_solution[81];
+    in_place_search_t search;
+    init_in_place_search(&search, NULL, options->branching, options->rules,
+                         limit, first_solution);
+    mrv_index_t index;
+    mrv_index_build(&index, board, board_domain);
+    search_in_place(board, board_domain, &index, &search, 0);
+    trail_destroy(&search.trail);
+
+    if (search.n_solutions > 0) {
+        memcpy(board, first_solution, sizeof(first_solution));
+    }
+    if (options->debug) {
+        printf("Found %d sol. (limit %d) after expanding %d nodes\n\n",
+               search.n_solutions, limit, search.expansion_count);
+    }
+    if (stats) {
+        stats->expansion_count = search.expansion_count;
+    }
+    return search.n_solutions;
+}
+
+// Shared by the threads of one sudoku_search_parallel call.
+// subtrees holds the roots of subtrees that nobody has searched yet.
+typedef struct parallel_search {
+    mutex lock;
+    condition_variable work_changed;
+    vector<sudoku_state_t*> subtrees;
+    int n_threads;
+    // search subtrees with tree_search instead of search_in_place
+    bool use_tree_search;
+    // threads currently splitting or searching a subtree
+    int n_busy;
+    atomic<bool> found;
+    atomic<int32_t> expansion_count;
+    // counters of the threads started for this search, once they finish
+    solve_stats_t thread_totals;
+    sudoku_state_t solution;
+} parallel_search_t;
+
+// must be called with search->lock held
+void record_solution(parallel_search_t *search, sudoku_state_t *state) {
+    if (!search->found) {
+        memcpy(&search->solution, state, sizeof(sudoku_state_t));
+        search->found = true;
+    }
+}
+
+// adds the children of state to subtrees, for other threads to take
+void split_subtree(parallel_search_t *search, sudoku_state_t *state) {
+    vector<sudoku_state_t*> children;
+    void *expansion = expand_state(state);
+    void *new_state = NULL;
+    int32_t new_action = -1;
+    while (next_new_state(expansion, &new_state, &new_action)) {
+        children.push_back((sudoku_state_t*)new_state);
+    }
+    search->expansion_count++;
+
+    lock_guard<mutex> guard(search->lock);
+    for (size_t i = 0; i < children.size(); i++) {
+        if (is_state_goal(children[i])) {
+            record_solution(search, children[i]);
+            free_state(children[i]);
+        } else {
+            search->subtrees.push_back(children[i]);
+        }
+    }
+}
+
+// runs a normal search below state, until done or another thread wins
+void search_subtree(parallel_search_t *search, sudoku_state_t *state) {
+    if (!search->use_tree_search) {
+        sudoku_state_t root = *state;
+        in_place_search_t subtree;
+        init_in_place_search(&subtree, &search->found, root.branching,
+                             root.rules, 1, NULL);
+        bool found = search_in_place(root.board, root.board_domain,
+                                     &root.index, &subtree, root.depth);
+        trail_destroy(&subtree.trail);
+        search->expansion_count += subtree.expansion_count;
+        if (found) {
+            lock_guard<mutex> guard(search->lock);
+            record_solution(search, &root);
+        }
+        return;
+    }
+
+    // states below this subtree stay on this thread, so they can share
+    // one pool without locking
+    pool_t state_pool;
+    pool_init(&state_pool, sizeof(sudoku_state_t));
+    sudoku_state_t root = *state;
+    root.pool = &state_pool;
+
+    general_search_problem_t p = { 0 };
+    init_sudoku_search(&p, &root);
+    sudoku_search_problem problem(&search->found);
+    // every search leaves it empty, and reusing it keeps its memory
+    static thread_local lifo_frontier frontier;
+    no_visited_set expanded_set;
+
+    gen_search_node_t *goal_node =
+                        tree_search(&p, problem, frontier, expanded_set);
+    search->expansion_count += p.expansion_count;
+    if (goal_node) {
+        {
+            lock_guard<mutex> guard(search->lock);
+            record_solution(search, (sudoku_state_t*)goal_node->state);
+        }
+        general_search_result_destroy(&p, problem, goal_node);
+    }
+    pool_destroy(&state_pool);
+}
+
+void parallel_search_worker(parallel_search_t *search) {
+    unique_lock<mutex> lock(search->lock);
+    while (1) {
+        while (search->subtrees.empty() && search->n_busy > 0 &&
+                !search->found) {
+            search->work_changed.wait(lock);
+        }
+        if (search->found || search->subtrees.empty()) {
+            // solved, or every subtree was exhausted without a solution
+            return;
+        }
+        sudoku_state_t *state = search->subtrees.back();
+        search->subtrees.pop_back();
+        search->n_busy++;
+        bool split = search->subtrees.size() <
+                        (size_t)(search->n_threads * PARALLEL_SPLIT_FACTOR);
+        lock.unlock();
+
+        if (split) {
+            split_subtree(search, state);
+        } else {
+            search_subtree(search, state);
+        }
+        free_state(state);
+
+        lock.lock();
+        search->n_busy--;
+        search->work_changed.notify_all();
+    }
+}
+
+// the threads sudoku_search_parallel starts, which hand their counters
+// back to the calling thread when done
+void parallel_search_thread(parallel_search_t *search) {
+    STATS_RESET();
+    parallel_search_worker(search);
+#ifdef SUDOKU_STATS
+    lock_guard<mutex> guard(search->lock);
+    STATS_MERGE_INTO(&search->thread_totals);
+#endif
+}
+
+// Like sudoku_search, but spreads one puzzle's search tree over n_threads.
+// Subtrees near the root are split off into a shared list whenever it runs
+// low, idle threads take subtrees from it, and every thread stops as soon
+// as any one of them finds a solution.
+bool sudoku_search_parallel(char *board, uint16_t *board_domain,
+                            solve_options_t *options, solve_stats_t *stats) {
+    int n_threads = options->n_threads;
+    bool debug = options->debug;
+    // subtree roots move between threads, so they don't use a pool
+    sudoku_state_t *state = alloc_state(NULL);
+    state->pool = NULL;
+    state->depth = 0;
+    state->trail = NULL;
+    state->branching = options->branching;
+    state->rules = options->rules;
+    memcpy(state->board, board, sizeof(state->board));
+    memcpy(state->board_domain, board_domain, sizeof(state->board_domain));
+    mrv_index_build(&state->index, board, board_domain);
+    if (is_state_goal(state)) {
+        free_state(state);
+        return true;
+    }
+
+    parallel_search_t search;
+    search.subtrees.push_back(state);
+    search.n_threads = n_threads;
+    search.use_tree_search = options->use_tree_search;
+    search.n_busy = 0;
+    search.found = false;
+    search.expansion_count = 0;
+    search.thread_totals = solve_stats_t();
+
+    vector<thread> threads;
+    for (int i = 1; i < n_threads; i++) {
+        threads.push_back(thread(parallel_search_thread, &search));
+    }
+    parallel_search_worker(&search);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    STATS_MERGE_FROM(&search.thread_totals);
+
+    // left over if another thread found the solution first
+    for (size_t i = 0; i < search.subtrees.size(); i++) {
+        free_state(search.subtrees[i]);
+    }
+    if (stats) {
+        stats->expansion_count = search.expansion_count;
+    }
+
+    if (!search.found) {
+        if (debug) {
+            printf("No solution found after expanding %d nodes\n",
+                   (int32_t)search.expansion_count);
+        }
+        return false;
+    }
+
+    if (debug) {
+        printf("Found sol. on %d threads after expanding %d nodes\n\n",
+                n_threads, (int32_t)search.expansion_count);
+    }
+
+    memcpy(board, search.solution.board, sizeof(search.solution.board));
+    memcpy(board_domain, search.solution.board_domain,
+                         sizeof(search.solution.board_domain));
+    return true;
 }
@@ -0,0 +1,289 @@
+#pragma once
+
+// Vectorized kernels for the propagation hot loops, with scalar fallbacks.
+// The AVX2 versions treat board_domain as five 16-lane vectors
+// (cells 0-79) plus cell 80 on its own, so no padding is needed.
+
+#include "sudoku.h"
+#include "sudoku_tables.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// lane k all ones when bit k of bits is set, all zeros otherwise
+inline __m256i expand_lane_mask(uint32_t bits) {
+    const __m256i lane_bits = _mm256_setr_epi16(
+        1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4, 1 << 5, 1 << 6, 1 << 7,
+        1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14,
+        (short)(1 << 15));
+    __m256i broadcast = _mm256_set1_epi16((short)bits);
+    return _mm256_cmpeq_epi16(_mm256_and_si256(broadcast, lane_bits),
+                              lane_bits);
+}
+
+// bit k set when lane k of lanes is all ones
+inline uint32_t lane_movemask(__m256i lanes) {
+    // packing to bytes leaves lanes 0-7 in bytes 0-7 and 8-15 in bytes 16-23
+    __m256i packed = _mm256_packs_epi16(lanes, _mm256_setzero_si256());
+    uint32_t bytes = _mm256_movemask_epi8(packed);
+    return (bytes & 0xff) | ((bytes >> 8) & 0xff00);
+}
+#endif
+
+// Removes the domain of solved cell i from all of its peers.
+// Unsolved peers left with a single option are solved and queued
+// in needs_reprocessing. Every changed cell is saved on trail, if given,
+// and the sections of i and of the changed cells are marked dirty.
+// returns false if this empties the domain of any peer
+inline bool eliminate_from_peers(char *board, uint16_t *board_domain,
+                                 uint64_t *needs_reprocessing, int i,
+                                 trail_t *trail) {
+    uint16_t mask_i = board_domain[i];
+    const uint64_t *peer_bits = TABLES.peer_bits[i];
+    uint32_t dirty = TABLES.cell_section_bits[i];
+
+#ifdef __AVX2__
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    __m256i mask = _mm256_set1_epi16(mask_i);
+    // 32-bit lanes, the sections of every changed cell OR-ed together
+    __m256i dirty_lanes = zero;
+    bool track_dirty = !sections_all_dirty(needs_reprocessing);
+    for (int first = 0; first < 80; first += 16) {
+        uint32_t bits = (first < 64 ? peer_bits[0] >> first
+                                    : peer_bits[1]) & 0xffff;
+        if (!bits) {
+            continue;
+        }
+        __m256i *domain_p = (__m256i*)&board_domain[first];
+        __m256i peers = expand_lane_mask(bits);
+        __m256i old_domain = _mm256_loadu_si256(domain_p);
+        __m256i domain = _mm256_andnot_si256(_mm256_and_si256(peers, mask),
+                                             old_domain);
+
+        // a solved peer holding our value ends up empty, as does
+        // an unsolved peer that had nothing else left
+        __m256i empty = _mm256_cmpeq_epi16(domain, zero);
+        if (lane_movemask(_mm256_and_si256(empty, peers))) {
+            return false;
+        }
+
+        __m256i single = _mm256_cmpeq_epi16(
+                            _mm256_and_si256(domain,
+                                             _mm256_sub_epi16(domain, one)),
+                            zero);
+        __m256i unsolved = _mm256_cmpeq_epi16(
+                            _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                                (__m128i*)&board[first])),
+                            zero);
+        uint32_t forced = lane_movemask(_mm256_and_si256(
+                            _mm256_and_si256(single, unsolved), peers));
+
+        __m256i same = _mm256_cmpeq_epi16(domain, old_domain);
+        if (track_dirty) {
+            // widened to line up with cell_section_bits, branch-free
+            __m256i same_lo = _mm256_cvtepi16_epi32(
+                                _mm256_castsi256_si128(same));
+            __m256i same_hi = _mm256_cvtepi16_epi32(
+                                _mm256_extracti128_si256(same, 1));
+            const __m256i *sections_p =
+                            (const __m256i*)&TABLES.cell_section_bits[first];
+            dirty_lanes = _mm256_or_si256(dirty_lanes, _mm256_andnot_si256(
+                                same_lo, _mm256_loadu_si256(sections_p)));
+            dirty_lanes = _mm256_or_si256(dirty_lanes, _mm256_andnot_si256(
+                                same_hi, _mm256_loadu_si256(sections_p + 1)));
+        }
+        if (trail) {
+            uint32_t touched = forced | (~lane_movemask(same) & 0xffff);
+            while (touched) {
+                int j = first + which_on_bit(touched);
+                touched &= touched - 1;
+                trail_save(trail, board, board_domain, j);
+            }
+        }
+        _mm256_storeu_si256(domain_p, domain);
+
+        while (forced) {
+            int j = first + which_on_bit(forced);
+            forced &= forced - 1;
+            board[j] = which_on_bit(board_domain[j]);
+            reprocessing_insert(needs_reprocessing, j);
+        }
+    }
+
+    // cell 80 falls past the last full vector
+    if (peer_bits[1] & ((uint64_t)1 << 16)) {
+        if (board_domain[80] & mask_i) {
+            dirty |= TABLES.cell_section_bits[80];
+        }
+        trail_save(trail, board, board_domain, 80);
+        board_domain[80] &= ~mask_i;
+        if (board_domain[80] == 0) {
+            return false;
+        }
+        if (board[80] == 0 && count_on_bits(board_domain[80]) == 1) {
+            board[80] = which_on_bit(board_domain[80]);
+            reprocessing_insert(needs_reprocessing, 80);
+        }
+    }
+    __m128i dirty_4 = _mm_or_si128(_mm256_castsi256_si128(dirty_lanes),
+                                   _mm256_extracti128_si256(dirty_lanes, 1));
+    dirty_4 = _mm_or_si128(dirty_4, _mm_shuffle_epi32(dirty_4, 0x4e));
+    dirty_4 = _mm_or_si128(dirty_4, _mm_shuffle_epi32(dirty_4, 0xb1));
+    dirty |= _mm_cvtsi128_si32(dirty_4);
+    sections_mark_dirty(needs_reprocessing, dirty);
+    return true;
+#else
+    (void)peer_bits;
+    const uint8_t *peers = TABLES.peers[i];
+    for (int peer_i = 0; peer_i < 20; peer_i++) {
+        int j = peers[peer_i];
+        if (board[j] != 0 || !(board_domain[j] & mask_i)) {
+            continue;
+        }
+        trail_save(trail, board, board_domain, j);
+        board_domain[j] &= ~mask_i;
+        dirty |= TABLES.cell_section_bits[j];
+        if (count_on_bits(board_domain[j]) == 1) {
+            int number = which_on_bit(board_domain[j]);
+            if (check_add_fails(board, needs_reprocessing, j, number)) {
+                // inconsistent -- we're done
+                return false;
+            }
+            board[j] = number;
+            reprocessing_insert(needs_reprocessing, j);
+        }
+    }
+    sections_mark_dirty(needs_reprocessing, dirty);
+    return true;
+#endif
+}
+
+// Sets *singles to the values that exactly one unsolved cell of section
+// can still take. returns false if a value is neither placed in section
+// nor left in any of its domains, so the board can't be solved.
+inline bool find_hidden_singles_for_section(char *board,
+                                            uint16_t *board_domain,
+                                            const uint8_t *section,
+                                            uint16_t *singles) {
+    uint16_t has_any_set_bits = 0;
+    uint16_t has_multiple_set_bits = 0;
+    uint16_t placed = 0;
+    for (int cell_i = 0; cell_i < 9; cell_i++) {
+        int i = section[cell_i];
+        if (board[i] == 0) {
+            has_multiple_set_bits |= has_any_set_bits & board_domain[i];
+            has_any_set_bits |= board_domain[i];
+        } else {
+            placed |= board_domain[i];
+        }
+    }
+    *singles = has_any_set_bits & ~has_multiple_set_bits;
+    return (has_any_set_bits | placed) == BITS_1_9_SET;
+}
+
+// For each of the 27 sections (in TABLES.sections order), finds the values
+// that exactly one unsolved cell of the section can still take.
+// returns false if a section has a value with no place left in it
+inline bool find_hidden_singles(char *board, uint16_t *board_domain,
+                                uint16_t *singles) {
+#ifdef __AVX2__
+    // domains of unsolved cells, zero for solved ones, and of every cell,
+    // padded so that 16 lanes starting at any row stay in bounds
+    alignas(32) uint16_t open[96];
+    alignas(32) uint16_t domains[96];
+    const __m256i zero = _mm256_setzero_si256();
+    for (int first = 0; first < 80; first += 16) {
+        __m256i unsolved = _mm256_cmpeq_epi16(
+                            _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                                (__m128i*)&board[first])),
+                            zero);
+        __m256i domain = _mm256_loadu_si256((__m256i*)&board_domain[first]);
+        _mm256_store_si256((__m256i*)&open[first],
+                           _mm256_and_si256(domain, unsolved));
+        _mm256_store_si256((__m256i*)&domains[first], domain);
+    }
+    _mm256_store_si256((__m256i*)&open[80], zero);
+    _mm256_store_si256((__m256i*)&domains[80], zero);
+    open[80] = board[80] ? 0 : board_domain[80];
+    domains[80] = board_domain[80];
+
+    // lane c of each row vector is column c. OR-ing rows together finds
+    // per-column values seen at least once and seen more than once.
+    // The same within each band of three rows gives the 3x3 sections.
+    // Alongside, covered ORs every domain, solved cells included, for the
+    // values each section still has a place for.
+    __m256i any = zero;
+    __m256i multiple = zero;
+    __m256i covered = zero;
+    uint16_t all_covered = BITS_1_9_SET;
+    for (int band = 0; band < 3; band++) {
+        __m256i band_any = zero;
+        __m256i band_multiple = zero;
+        __m256i band_covered = zero;
+        for (int row = band * 3; row < band * 3 + 3; row++) {
+            __m256i domain = _mm256_loadu_si256((__m256i*)&open[row * 9]);
+            band_multiple = _mm256_or_si256(band_multiple,
+                                _mm256_and_si256(band_any, domain));
+            band_any = _mm256_or_si256(band_any, domain);
+            band_covered = _mm256_or_si256(band_covered, _mm256_loadu_si256(
+                                (__m256i*)&domains[row * 9]));
+        }
+        multiple = _mm256_or_si256(multiple, _mm256_or_si256(band_multiple,
+                                    _mm256_and_si256(any, band_any)));
+        any = _mm256_or_si256(any, band_any);
+        covered = _mm256_or_si256(covered, band_covered);
+
+        alignas(32) uint16_t col_any[16];
+        alignas(32) uint16_t col_multiple[16];
+        alignas(32) uint16_t col_covered[16];
+        _mm256_store_si256((__m256i*)col_any, band_any);
+        _mm256_store_si256((__m256i*)col_multiple, band_multiple);
+        _mm256_store_si256((__m256i*)col_covered, band_covered);
+        for (int box_col = 0; box_col < 9; box_col += 3) {
+            uint16_t box_any = 0;
+            uint16_t box_multiple = 0;
+            uint16_t box_covered = 0;
+            for (int col = box_col; col < box_col + 3; col++) {
+                box_multiple |= col_multiple[col] | (box_any & col_any[col]);
+                box_any |= col_any[col];
+                box_covered |= col_covered[col];
+            }
+            singles[18 + band * 3 + box_col / 3] = box_any & ~box_multiple;
+            all_covered &= box_covered;
+        }
+    }
+    alignas(32) uint16_t col_singles[16];
+    alignas(32) uint16_t col_covered[16];
+    _mm256_store_si256((__m256i*)col_singles,
+                       _mm256_andnot_si256(multiple, any));
+    _mm256_store_si256((__m256i*)col_covered, covered);
+    for (int col = 0; col < 9; col++) {
+        singles[9 + col] = col_singles[col];
+        all_covered &= col_covered[col];
+    }
+
+    // rows run along the lanes, so these stay scalar (but branch-free)
+    for (int row = 0; row < 9; row++) {
+        uint16_t row_any = 0;
+        uint16_t row_multiple = 0;
+        uint16_t row_covered = 0;
+        for (int col = 0; col < 9; col++) {
+            row_multiple |= row_any & open[row * 9 + col];
+            row_any |= open[row * 9 + col];
+            row_covered |= domains[row * 9 + col];
+        }
+        singles[row] = row_any & ~row_multiple;
+        all_covered &= row_covered;
+    }
+    return all_covered == BITS_1_9_SET;
+#else
+    bool normal = true;
+    for (int section_i = 0; section_i < 27; section_i++) {
+        normal &= find_hidden_singles_for_section(
+                    board, board_domain, TABLES.sections[section_i],
+                    &singles[section_i]);
+    }
+    return normal;
+#endif
+}
@@ -0,0 +1,63 @@
+#include "sudoku_stats.h"
+
+#ifdef SUDOKU_STATS
+thread_local solve_stats_t thread_stats;
+#endif
+
+void solve_stats_add(solve_stats_t *total, solve_stats_t *stats) {
+    total->expansion_count += stats->expansion_count;
+    total->ac3_pops += stats->ac3_pops;
+    total->hidden_singles += stats->hidden_singles;
+    total->subset_reductions += stats->subset_reductions;
+    total->locked_candidates += stats->locked_candidates;
+    total->general_subsets += stats->general_subsets;
+    total->fish += stats->fish;
+    total->guesses += stats->guesses;
+    total->backtracks += stats->backtracks;
+    if (stats->max_depth > total->max_depth) {
+        total->max_depth = stats->max_depth;
+    }
+    total->ac3_seconds += stats->ac3_seconds;
+    total->hidden_single_seconds += stats->hidden_single_seconds;
+    total->subset_seconds += stats->subset_seconds;
+    total->extra_rules_seconds += stats->extra_rules_seconds;
+    total->search_seconds += stats->search_seconds;
+}
+
+// writes stats as one JSON object, its lines after the first
+// starting with indent
+void write_stats_json(FILE *f, solve_stats_t *stats, const char *indent) {
+#ifdef SUDOKU_STATS
+    bool counters_enabled = true;
+#else
+    bool counters_enabled = false;
+#endif
+    fprintf(f, "{\n");
+    fprintf(f, "%s  \"counters_enabled\": %s,\n",
+            indent, counters_enabled ? "true" : "false");
+    fprintf(f, "%s  \"expansion_count\": %lld,\n",
+            indent, (long long)stats->expansion_count);
+    fprintf(f, "%s  \"ac3_pops\": %lld,\n",
+            indent, (long long)stats->ac3_pops);
+    fprintf(f, "%s  \"hidden_singles\": %lld,\n",
+            indent, (long long)stats->hidden_singles);
+    fprintf(f, "%s  \"subset_reductions\": %lld,\n",
+            indent, (long long)stats->subset_reductions);
+    fprintf(f, "%s  \"locked_candidates\": %lld,\n",
+            indent, (long long)stats->locked_candidates);
+    fprintf(f, "%s  \"general_subsets\": %lld,\n",
+            indent, (long long)stats->general_subsets);
+    fprintf(f, "%s  \"fish\": %lld,\n", indent, (long long)stats->fish);
+    fprintf(f, "%s  \"guesses\": %lld,\n",
+            indent, (long long)stats->guesses);
+    fprintf(f, "%s  \"backtracks\": %lld,\n",
+            indent, (long long)stats->backtracks);
+    fprintf(f, "%s  \"max_depth\": %d,\n", indent, stats->max_depth);
+    fprintf(f, "%s  \"seconds\": {\"ac3\": %.6f, \"hidden_singles\": %.6f, "
+               "\"subsets\": %.6f, \"extra_rules\": %.6f, "
+               "\"search\": %.6f}\n",
+            indent, stats->ac3_seconds, stats->hidden_single_seconds,
+            stats->subset_seconds, stats->extra_rules_seconds,
+            stats->search_seconds);
+    fprintf(f, "%s}", indent);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// What one solve() call did, or the sum over many of them.
+// expansion_count is always kept. The other counters are only kept when
+// built with SUDOKU_STATS defined (make STATS=1), and stay 0 otherwise,
+// so a normal build pays nothing for them.
+typedef struct solve_stats {
+    // search nodes expanded, 0 when propagation alone solved the puzzle
+    int64_t expansion_count;
+    // solved cells popped by run_ac3 to eliminate from their peers
+    int64_t ac3_pops;
+    // cells placed by run_only_viable as the only place for a value
+    int64_t hidden_singles;
+    // domains reduced by run_n_domain_reduction's naked subsets
+    int64_t subset_reductions;
+    // candidates removed by the rules of run_extra_rules
+    int64_t locked_candidates;
+    int64_t general_subsets;
+    int64_t fish;
+    // values tried for a search decision cell
+    int64_t guesses;
+    // guesses that were undone after they led to an inconsistent board
+    int64_t backtracks;
+    // most guesses made on one path from the root
+    int32_t max_depth;
+    // time in each phase of run_constraint_update. Hidden singles time
+    // includes the peer eliminations its placements run.
+    double ac3_seconds;
+    double hidden_single_seconds;
+    double subset_seconds;
+    double extra_rules_seconds;
+    // time in the search, including the propagation it runs
+    double search_seconds;
+} solve_stats_t;
+
+void solve_stats_add(solve_stats_t *total, solve_stats_t *stats);
+void write_stats_json(FILE *f, solve_stats_t *stats, const char *indent);
+
+#ifdef SUDOKU_STATS
+// counters of the solve() running on this thread
+extern thread_local solve_stats_t thread_stats;
+
+#define STATS_ADD(field, n) (thread_stats.field += (n))
+#define STATS_MAX(field, value) \
+    (thread_stats.field = thread_stats.field > (value) ? \
+                          thread_stats.field : (value))
+// STATS_TIMER(name) starts a timer, STATS_TIME(name, field) adds the time
+// since then to field
+#define STATS_TIMER(name) double name = seconds()
+#define STATS_TIME(name, field) (thread_stats.field += seconds() - (name))
+#define STATS_RESET() (thread_stats = solve_stats_t())
+// adds the counters of this thread to *total
+#define STATS_MERGE_INTO(total) solve_stats_add((total), &thread_stats)
+// adds *stats to the counters of this thread
+#define STATS_MERGE_FROM(stats) solve_stats_add(&thread_stats, (stats))
+#else
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_MAX(field, value) ((void)0)
+#define STATS_TIMER(name) ((void)0)
+#define STATS_TIME(name, field) ((void)0)
+#define STATS_RESET() ((void)0)
+#define STATS_MERGE_INTO(total) ((void)0)
+#define STATS_MERGE_FROM(stats) ((void)0)
+#endif
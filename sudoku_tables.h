@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+// Lookup tables for the 9x9 board, all computed at compile time.
+// Cells are numbered 0-80 in row-major order.
+typedef struct sudoku_tables {
+    // the 27 sections which must each hold 1-9 once:
+    // 9 rows, then 9 columns, then the 9 3x3 boxes
+    uint8_t sections[27][9];
+    // the row, column, and 3x3 section index of each cell
+    uint8_t cell_sections[81][3];
+    // the same three sections as a bitmask, bit-0 for section 0
+    uint32_t cell_section_bits[81];
+    // the cells of each section as a bitmask, split like peer_bits
+    uint64_t section_cell_bits[27][2];
+    // the 20 other cells sharing a row, column, or 3x3 with each cell
+    uint8_t peers[81][20];
+    // the same peers as a bitmask, bit-0 for cell 0 and so forth,
+    // split over two 64-bit ints like needs_reprocessing
+    uint64_t peer_bits[81][2];
+    // random keys for Zobrist hashing a board: the XOR of zobrist[i][n]
+    // over every cell i solved as n. zobrist[i][0] is 0, so unsolved
+    // cells add nothing.
+    uint64_t zobrist[81][10];
+} sudoku_tables_t;
+
+constexpr sudoku_tables_t make_sudoku_tables() {
+    sudoku_tables_t t = {};
+
+    for (int row = 0; row < 9; row++) {
+        for (int col = 0; col < 9; col++) {
+            int i = row * 9 + col;
+            int box = (row / 3) * 3 + col / 3;
+            int box_i = (row % 3) * 3 + col % 3;
+            t.sections[row][col] = i;
+            t.sections[9 + col][row] = i;
+            t.sections[18 + box][box_i] = i;
+            t.cell_sections[i][0] = row;
+            t.cell_sections[i][1] = 9 + col;
+            t.cell_sections[i][2] = 18 + box;
+            t.cell_section_bits[i] = (uint32_t)1 << row |
+                                     (uint32_t)1 << (9 + col) |
+                                     (uint32_t)1 << (18 + box);
+            for (int s = 0; s < 3; s++) {
+                t.section_cell_bits[t.cell_sections[i][s]][i / 64] |=
+                                    (uint64_t)1 << (i % 64);
+            }
+        }
+    }
+
+    for (int i = 0; i < 81; i++) {
+        int row = i / 9;
+        int col = i % 9;
+        int n_peers = 0;
+        for (int j = 0; j < 81; j++) {
+            int row_j = j / 9;
+            int col_j = j % 9;
+            bool same_box = row / 3 == row_j / 3 && col / 3 == col_j / 3;
+            if (j != i && (row == row_j || col == col_j || same_box)) {
+                t.peers[i][n_peers++] = j;
+                t.peer_bits[i][j / 64] |= (uint64_t)1 << (j % 64);
+            }
+        }
+    }
+
+    // splitmix64, fixed so hashes are the same from run to run
+    uint64_t seed = 0;
+    for (int i = 0; i < 81; i++) {
+        for (int n = 1; n <= 9; n++) {
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            t.zobrist[i][n] = z ^ (z >> 31);
+        }
+    }
+
+    return t;
+}
+
+constexpr sudoku_tables_t TABLES = make_sudoku_tables();
@@ -1,26 +1,24 @@
 #include "unordered_set.h"
-#include <unordered_set>
-
-using std::unordered_set;
-
-typedef unordered_set<uint64_t> set_t;
+#include "visited_sets.h"
 
 void *unordered_set_make() {
-    return new set_t();
+    return new hash_visited_set();
 }
 
 void unordered_set_destroy(void *s) {
-    delete (set_t*)s;
+    delete (hash_visited_set*)s;
 }
 
 void unordered_set_add(void *s, uint64_t value) {
-    set_t *set = (set_t*)s;
-    set->insert(value);
+    ((hash_visited_set*)s)->add(value);
 }
 
 bool unordered_set_contains(void *s, uint64_t value) {
-    set_t *set = (set_t*)s;
-    return set->count(value) != 0;
+    return ((hash_visited_set*)s)->contains(value);
+}
+
+void unordered_set_reserve(void *s, size_t n) {
+    ((hash_visited_set*)s)->reserve(n);
 }
 
 void populate_with_unordered_set(general_search_problem_t *p) {
@@ -28,4 +26,5 @@ void populate_with_unordered_set(general_search_problem_t *p) {
     p->unordered_set_destroy = unordered_set_destroy;
     p->unordered_set_add = unordered_set_add;
     p->unordered_set_contains = unordered_set_contains;
+    p->unordered_set_reserve = unordered_set_reserve;
 }
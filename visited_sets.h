@@ -0,0 +1,181 @@
+#pragma once
+
+// Expanded-state sets for the templated tree_search in search_engine.h.
+// unordered_set.cpp wraps hash_visited_set for populate_with_unordered_set.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Open-addressing set of 64-bit state hashes, in one flat array instead of
+// an allocation per entry like std::unordered_set.
+// Slots come 4 to a 32-byte bucket, and a lookup compares all 4 at once
+// (with AVX2), moving on to the next bucket only while this one is full.
+// 0 marks an empty slot, so a hash of 0 is kept in a flag of its own.
+// Nothing is ever removed, so the first bucket with an empty slot ends
+// every probe. clear() keeps the memory for the next search.
+class hash_visited_set {
+    static const int BUCKET_SLOTS = 4;
+    static const size_t MIN_BUCKETS = 16;
+
+    uint64_t *slots;
+    size_t n_buckets;
+    // 64 - log2(n_buckets), to take a bucket from the top bits of a hash
+    int shift;
+    size_t size;
+    bool has_zero;
+
+    // hashes like pointers have their entropy in the low bits, so they are
+    // spread over every bit before picking a bucket
+    size_t bucket_of(uint64_t hash) {
+        return (hash * 0x9e3779b97f4a7c15ULL) >> shift;
+    }
+
+    void allocate(size_t buckets) {
+        n_buckets = buckets;
+        shift = 64 - __builtin_ctzll(buckets);
+        size_t bytes = n_buckets * BUCKET_SLOTS * sizeof(uint64_t);
+        slots = (uint64_t*)aligned_alloc(32, bytes);
+        if (!slots) {
+            fprintf(stderr, "Fatal Error: hash_visited_set failed to "
+                            "allocate %zu bytes\n", bytes);
+            exit(1);
+        }
+        memset(slots, 0, bytes);
+    }
+
+    // grows to hold n hashes with buckets at most 3/4 full on average
+    void grow(size_t n) {
+        size_t buckets = n_buckets;
+        while (n * 4 > buckets * BUCKET_SLOTS * 3) {
+            buckets *= 2;
+        }
+        if (buckets == n_buckets) {
+            return;
+        }
+        uint64_t *old_slots = slots;
+        size_t old_n_slots = n_buckets * BUCKET_SLOTS;
+        allocate(buckets);
+        for (size_t k = 0; k < old_n_slots; k++) {
+            if (old_slots[k]) {
+                insert_new(old_slots[k]);
+            }
+        }
+        free(old_slots);
+    }
+
+    // puts a nonzero hash known not to be in the set in the first free slot
+    void insert_new(uint64_t hash) {
+        size_t b = bucket_of(hash);
+        while (1) {
+            uint64_t *bucket = &slots[b * BUCKET_SLOTS];
+            for (int k = 0; k < BUCKET_SLOTS; k++) {
+                if (!bucket[k]) {
+                    bucket[k] = hash;
+                    return;
+                }
+            }
+            b = (b + 1) & (n_buckets - 1);
+        }
+    }
+
+    // Looks for a nonzero hash. If it isn't there, *free_slot is set to
+    // where it would go.
+    bool find(uint64_t hash, uint64_t **free_slot) {
+        size_t b = bucket_of(hash);
+#ifdef __AVX2__
+        __m256i wanted = _mm256_set1_epi64x(hash);
+        __m256i empty = _mm256_setzero_si256();
+#endif
+        while (1) {
+            uint64_t *bucket = &slots[b * BUCKET_SLOTS];
+#ifdef __AVX2__
+            __m256i keys = _mm256_load_si256((__m256i*)bucket);
+            if (_mm256_movemask_pd(_mm256_castsi256_pd(
+                            _mm256_cmpeq_epi64(keys, wanted)))) {
+                return true;
+            }
+            int free_mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+                            _mm256_cmpeq_epi64(keys, empty)));
+            if (free_mask) {
+                *free_slot = &bucket[__builtin_ctz(free_mask)];
+                return false;
+            }
+#else
+            for (int k = 0; k < BUCKET_SLOTS; k++) {
+                if (bucket[k] == hash) {
+                    return true;
+                }
+                if (!bucket[k]) {
+                    *free_slot = &bucket[k];
+                    return false;
+                }
+            }
+#endif
+            b = (b + 1) & (n_buckets - 1);
+        }
+    }
+
+ public:
+    hash_visited_set() : size(0), has_zero(false) {
+        allocate(MIN_BUCKETS);
+    }
+    ~hash_visited_set() {
+        free(slots);
+    }
+    hash_visited_set(const hash_visited_set &) = delete;
+    hash_visited_set &operator=(const hash_visited_set &) = delete;
+
+    void clear() {
+        if (size > 0) {
+            memset(slots, 0, n_buckets * BUCKET_SLOTS * sizeof(uint64_t));
+        }
+        size = 0;
+        has_zero = false;
+    }
+    // sizes the set for n hashes up front, so it doesn't rehash on the way
+    void reserve(size_t n) {
+        grow(n);
+    }
+    void add(uint64_t hash) {
+        if (hash == 0) {
+            has_zero = true;
+            return;
+        }
+        uint64_t *free_slot;
+        if (find(hash, &free_slot)) {
+            return;
+        }
+        if ((size + 1) * 4 > n_buckets * BUCKET_SLOTS * 3) {
+            grow(size + 1);
+            find(hash, &free_slot);
+        }
+        *free_slot = hash;
+        size++;
+    }
+    bool contains(uint64_t hash) {
+        if (hash == 0) {
+            return has_zero;
+        }
+        uint64_t *free_slot;
+        return find(hash, &free_slot);
+    }
+};
+
+// for searches that allow cycles, where the set is never consulted
+class no_visited_set {
+ public:
+    void clear() {
+    }
+    void reserve(size_t n) {
+    }
+    void add(uint64_t hash) {
+    }
+    bool contains(uint64_t hash) {
+        return false;
+    }
+};